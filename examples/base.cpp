@@ -79,7 +79,7 @@ int main() {
         // cout << keys[i] << endl;
     }
 
-    std::cout <<"number of gpl model: " << index.nodes.size() << std::endl;
+    std::cout <<"number of gpl model: " << index.directory.size() << std::endl;
 //    std::cout << index.buffer->memory_consumption() << std::endl;
     //test find
     for(int i = 0 ; i < table_size ; i++) {
@@ -5,6 +5,7 @@
 
 #include <atomic>
 #include <array>
+#include <utility>
 #include <vector>
 #include "tbb/enumerable_thread_specific.h"
 #include "tbb/combinable.h"
@@ -14,11 +15,15 @@ namespace ART{
     constexpr uint32_t NUMBER_EPOCHS = 3;
     constexpr uint32_t NOT_IN_EPOCH = NUMBER_EPOCHS;
 
+    // frees an object once no thread can reach it anymore
+    using Deleter = void (*)(void *pointer);
+
     class ThreadSpecificEpochBasedReclamationInformation {
-        std::array <std::vector<void *>, NUMBER_EPOCHS> mFreeLists;
+        std::array <std::vector<std::pair<void *, Deleter>>, NUMBER_EPOCHS> mFreeLists;
         std::atomic <uint32_t> mLocalEpoch;
         uint32_t mPreviouslyAccessedEpoch;
         bool mThreadWantsToAdvance;
+        uint32_t mNesting = 0; // guards of the thread, only the outermost one enters and leaves the epoch
 
     public:
         static std::atomic <size_t> mNumberFrees;
@@ -39,10 +44,10 @@ namespace ART{
             }
         }
 
-        void scheduleForDeletion(void *childPointer) {
+        void scheduleForDeletion(void *childPointer, Deleter deleter) {
             assert(mLocalEpoch != NOT_IN_EPOCH);
-            std::vector<void *> &currentFreeList = mFreeLists[mLocalEpoch];
-            currentFreeList.emplace_back(childPointer);
+            std::vector<std::pair<void *, Deleter>> &currentFreeList = mFreeLists[mLocalEpoch];
+            currentFreeList.emplace_back(childPointer, deleter);
             mThreadWantsToAdvance = (currentFreeList.size() % 64u) == 0;
         }
 
@@ -57,7 +62,8 @@ namespace ART{
                 mThreadWantsToAdvance = false;
                 mPreviouslyAccessedEpoch = newEpoch;
             }
-            mLocalEpoch.store(newEpoch, std::memory_order_release);
+            // ordered before the check of the global epoch in enterCriticalSection
+            mLocalEpoch.store(newEpoch, std::memory_order_seq_cst);
         }
 
         void leave() {
@@ -68,11 +74,20 @@ namespace ART{
             return (mThreadWantsToAdvance);
         }
 
+        // returns true for the outermost guard
+        bool nest() {
+            return mNesting++ == 0;
+        }
+
+        bool unnest() {
+            return --mNesting == 0;
+        }
+
     private:
         void freeForEpoch(uint32_t epoch) {
-            std::vector<void *> &previousFreeList = mFreeLists[epoch];
-            for (void *pointer : previousFreeList) {
-                delete pointer;
+            std::vector<std::pair<void *, Deleter>> &previousFreeList = mFreeLists[epoch];
+            for (auto &entry : previousFreeList) {
+                entry.second(entry.first);
             }
             previousFreeList.resize(0u);
         }
@@ -101,8 +116,19 @@ namespace ART{
 
         void enterCriticalSection() {
             ThreadSpecificEpochBasedReclamationInformation &currentMemoryInformation = mThreadSpecificInformations.local();
+            if (!currentMemoryInformation.nest()) {
+                return;
+            }
             uint32_t currentEpoch = mCurrentEpoch.load(std::memory_order_acquire);
             currentMemoryInformation.enter(currentEpoch);
+            // a thread preempted between loading and publishing the epoch may publish one the global epoch
+            // has wrapped around to meanwhile, which does not hold back the objects of lagging threads
+            for (uint32_t latestEpoch = mCurrentEpoch.load(std::memory_order_seq_cst); latestEpoch != currentEpoch;
+                 latestEpoch = mCurrentEpoch.load(std::memory_order_seq_cst)) {
+                currentMemoryInformation.leave();
+                currentEpoch = latestEpoch;
+                currentMemoryInformation.enter(currentEpoch);
+            }
             if (currentMemoryInformation.doesThreadWantToAdvanceEpoch() && canAdvance(currentEpoch)) {
                 mCurrentEpoch.compare_exchange_strong(currentEpoch, NEXT_EPOCH[currentEpoch]);
             }
@@ -118,11 +144,13 @@ namespace ART{
 
         void leaveCriticialSection() {
             ThreadSpecificEpochBasedReclamationInformation &currentMemoryInformation = mThreadSpecificInformations.local();
-            currentMemoryInformation.leave();
+            if (currentMemoryInformation.unnest()) {
+                currentMemoryInformation.leave();
+            }
         }
 
-        void scheduleForDeletion(void *childPointer) {
-            mThreadSpecificInformations.local().scheduleForDeletion(childPointer);
+        void scheduleForDeletion(void *childPointer, Deleter deleter) {
+            mThreadSpecificInformations.local().scheduleForDeletion(childPointer, deleter);
         }
     };
 
@@ -156,9 +184,10 @@ namespace ART{
 
         EpochBasedMemoryReclamationStrategy *mMemoryReclamation;
 
+        Deleter mNodeDeleter;
 
     public:
-        Epoche(size_t startGCThreshhold) {
+        Epoche(size_t startGCThreshhold, Deleter nodeDeleter) : mNodeDeleter(nodeDeleter) {
             mMemoryReclamation = EpochBasedMemoryReclamationStrategy::getInstance();
             (mMemoryReclamation->mThreadSpecificInformations).clear();
         }
@@ -171,7 +200,11 @@ namespace ART{
         }
 
         void markNodeForDeletion(void *n, ThreadInfo &epocheInfo) {
-            mMemoryReclamation->scheduleForDeletion(n);
+            mMemoryReclamation->scheduleForDeletion(n, mNodeDeleter);
+        }
+
+        void markForDeletion(void *pointer, Deleter deleter, ThreadInfo &epocheInfo) {
+            mMemoryReclamation->scheduleForDeletion(pointer, deleter);
         }
 
         void exitEpocheAndCleanup(ThreadInfo &info) {
@@ -5,84 +5,220 @@
 #ifndef ALT_INDEX_FASTPOINTERBUFFER_H
 #define ALT_INDEX_FASTPOINTERBUFFER_H
 
+#include <atomic>
+#include <cassert>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include "N.h"
 #include "../concurrency.h"
 
 namespace ART_OLC {
 
+    /*
+     * Append-only table of fast pointers. Items live in chunks that double in size and are never moved,
+     * so an index stays valid while other threads append or repoint items.
+     */
     class FastPointerBuffer {
 
     public:
         FastPointerBuffer() {
-            pointer_buffer.reserve(10000000);
+            for(auto &chunk : chunks){
+                chunk.store(nullptr, std::memory_order_relaxed);
+            }
         }
 
         ~FastPointerBuffer() {
-            for(int i = 0 ; i < pointer_buffer.size() ; i++){
-                delete &pointer_buffer[i];
+            for(auto &chunk : chunks){
+                delete[] chunk.load(std::memory_order_relaxed);
             }
         }
 
+        //retrains build fast pointers while the index is in use
         int insertFastPointer(N* pointer){
-            for(int i = 0 ; i < pointer_buffer.size() ; i++){
-                if(pointer == pointer_buffer[i].fast_pointer){
-                    return i;
-                }
+            IndexShard &shard = shardOf(pointer);
+            std::lock_guard<alt_index::spin_lock> guard(shard.lock);
+            auto it = shard.first_item.find(pointer);
+            if(it != shard.first_item.end()){
+                return it->second;
             }
-            pointer_buffer.push_back(FastPointerItem(pointer));
-            return pointer_buffer.size() - 1;
+            int index = append(pointer);
+            shard.first_item.emplace(pointer, index);
+            return index;
         }
 
         struct FastPointerItem {
-            N *fast_pointer;
-            alt_index::spin_lock *lock_;
-
-            FastPointerItem(N* pointer) : fast_pointer(pointer){
-                lock_ = new alt_index::spin_lock();
-            }
-
-            ~FastPointerItem(){}
+            std::atomic<N *> fast_pointer{nullptr};    //nullptr until the item is appended
+            int next = -1;  //next item pointing to the same node, -1 at the end
         };
 
-        FastPointerItem getFastPointer(int pointerIndex) const {
-            return pointer_buffer[pointerIndex];
+        N *getFastPointer(int pointerIndex) const {
+            return item(pointerIndex).fast_pointer.load(std::memory_order_acquire);
         }
 
         int getFastPointerIndex(N* pointer){
-            for(int i = 0 ; i < pointer_buffer.size() ; i++){
-                if(pointer == pointer_buffer[i].fast_pointer){
-                    return i;
-                }
-            }
-            return pointer_buffer.size();
+            IndexShard &shard = shardOf(pointer);
+            std::lock_guard<alt_index::spin_lock> guard(shard.lock);
+            auto it = shard.first_item.find(pointer);
+            return it != shard.first_item.end() ? it->second : size();
         }
 
         bool updateFastPointerWithIndex(int index, N* new_pointer){
-            if(index >= pointer_buffer.size()){
+            if(index >= size()){
                 return false;
             }
-            pointer_buffer[index].fast_pointer = new_pointer;
+            FastPointerItem &moved = item(index);
+            N *old_pointer = moved.fast_pointer.load(std::memory_order_relaxed);
+            if(old_pointer == new_pointer){
+                return true;
+            }
+            IndexShard &from = shardOf(old_pointer), &to = shardOf(new_pointer);
+            lockShards(from, to);
+            //unchain the item from the old node
+            auto it = from.first_item.find(old_pointer);
+            if(it->second == index){
+                if(moved.next == -1){
+                    from.first_item.erase(it);
+                }else{
+                    it->second = moved.next;
+                }
+            }else{
+                int prev = it->second;
+                while(item(prev).next != index){
+                    prev = item(prev).next;
+                }
+                item(prev).next = moved.next;
+            }
+            moved.fast_pointer.store(new_pointer, std::memory_order_release);
+            auto res = to.first_item.emplace(new_pointer, index);
+            moved.next = res.second ? -1 : res.first->second;
+            if(!res.second){
+                res.first->second = index;
+            }
+            unlockShards(from, to);
             return true;
         }
 
+        //redirect every fast pointer to a node replaced by a grow, shrink or remove
+        void replaceFastPointer(N* old_pointer, N* new_pointer){
+            if(old_pointer == new_pointer){
+                return;
+            }
+            IndexShard &from = shardOf(old_pointer), &to = shardOf(new_pointer);
+            lockShards(from, to);
+            auto it = from.first_item.find(old_pointer);
+            if(it != from.first_item.end()){
+                int first = it->second, last = first;
+                from.first_item.erase(it);
+                for(int i = first ; i != -1 ; i = item(i).next){
+                    item(i).fast_pointer.store(new_pointer, std::memory_order_release);
+                    last = i;
+                }
+                //fast pointers of both nodes now share one chain
+                auto res = to.first_item.emplace(new_pointer, first);
+                if(!res.second){
+                    item(last).next = res.first->second;
+                    res.first->second = first;
+                }
+            }
+            unlockShards(from, to);
+        }
+
         bool isempty(){
-            return pointer_buffer.size() == 0;
+            return size() == 0;
         }
 
-        int size(){
-            return pointer_buffer.size();
+        int size() const {
+            return std::min(item_count.load(std::memory_order_acquire), capacity());
         }
 
         //get the match level of each fast pointer
         void pointerSavedPath(std::vector<uint64_t>& res){
-            for(uint64_t i = 0 ; i < pointer_buffer.size() ; i++){
-                res.push_back(pointer_buffer[i].fast_pointer->getMatchLevel());
+            for(int i = 0 ; i < size() ; i++){
+                //an item appended concurrently may not be visible yet
+                FastPointerItem *chunk = chunks[chunkOf(i)].load(std::memory_order_acquire);
+                N *pointer = chunk != nullptr ? chunk[offsetOf(i)].fast_pointer.load(std::memory_order_acquire) : nullptr;
+                if(pointer != nullptr){
+                    res.push_back(pointer->getMatchLevel());
+                }
             }
         }
 
-    public:
-        std::vector<FastPointerItem> pointer_buffer;
+    private:
+        static constexpr int FIRST_CHUNK_BITS = 10;
+        static constexpr int MAX_CHUNKS = 21;   //2^31 - 1024 items
+
+        static int capacity(){
+            return static_cast<int>(((1ull << MAX_CHUNKS) - 1) << FIRST_CHUNK_BITS);
+        }
+
+        //chunk c holds the 1024 * 2^c items following those of the chunks before it
+        static int chunkOf(int index){
+            return 63 - __builtin_clzll((static_cast<uint64_t>(index) >> FIRST_CHUNK_BITS) + 1);
+        }
+
+        static int offsetOf(int index){
+            return index - static_cast<int>(((1ull << chunkOf(index)) - 1) << FIRST_CHUNK_BITS);
+        }
+
+        FastPointerItem &item(int index) const {
+            return chunks[chunkOf(index)].load(std::memory_order_acquire)[offsetOf(index)];
+        }
+
+        //reserves the next item without locking, the first thread to reach a chunk allocates it
+        int append(N* pointer){
+            int index = item_count.fetch_add(1, std::memory_order_acq_rel);
+            assert(index < capacity());
+            int c = chunkOf(index);
+            FastPointerItem *chunk = chunks[c].load(std::memory_order_acquire);
+            if(chunk == nullptr){
+                FastPointerItem *fresh = new FastPointerItem[static_cast<std::size_t>(1) << (c + FIRST_CHUNK_BITS)];
+                if(chunks[c].compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)){
+                    chunk = fresh;
+                }else{
+                    delete[] fresh;
+                }
+            }
+            chunk[offsetOf(index)].fast_pointer.store(pointer, std::memory_order_release);
+            return index;
+        }
+
+        std::atomic<FastPointerItem *> chunks[MAX_CHUNKS];
+        std::atomic<int> item_count{0};
+
+        static constexpr int INDEX_SHARDS = 64;
+
+        //first item of every node with fast pointers, the items of a node are chained by next
+        struct IndexShard {
+            alt_index::spin_lock lock;
+            std::unordered_map<N*, int> first_item;
+        };
+
+        IndexShard &shardOf(N* pointer){
+            return shards[((reinterpret_cast<uintptr_t>(pointer) >> 4) * 0x9E3779B97F4A7C15ull >> 32) % INDEX_SHARDS];
+        }
+
+        //in address order, so that two replacements cannot deadlock
+        static void lockShards(IndexShard &a, IndexShard &b){
+            if(&a == &b){
+                a.lock.lock();
+            }else if(&a < &b){
+                a.lock.lock();
+                b.lock.lock();
+            }else{
+                b.lock.lock();
+                a.lock.lock();
+            }
+        }
+
+        static void unlockShards(IndexShard &a, IndexShard &b){
+            a.lock.unlock();
+            if(&a != &b){
+                b.lock.unlock();
+            }
+        }
+
+        IndexShard shards[INDEX_SHARDS];
     };
 
 }
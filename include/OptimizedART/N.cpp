@@ -119,7 +119,8 @@ namespace ART_OLC {
 
         N::change(parentNode, keyParent, nBig);
 
-        n->writeUnlock();
+        // fast pointers to n are redirected by the caller, operations starting from n restart meanwhile
+        n->writeUnlockObsolete();
 //        threadInfo.getEpoche().markNodeForDeletion(n, threadInfo);
         parentNode->writeUnlock();
         return ret;
@@ -287,6 +288,7 @@ namespace ART_OLC {
                 break;
             }
         }
+        return ret;
     }
 
     bool N::isLocked(uint64_t version) const {
@@ -355,6 +357,8 @@ namespace ART_OLC {
             this->prefix[prefixCopyCount - 1] = key;
         }
         this->prefixCount += node->getPrefixLength() + 1;
+        // the prefix starts where the prefix of the removed node started
+        this->match_level = node->getMatchLevel();
     }
 
 
@@ -383,12 +387,27 @@ namespace ART_OLC {
         }
     }
 
+    void N::freeNode(void *node) {
+        deleteNode(static_cast<N *>(node));
+    }
+
+    SlabStats N::slabStats(NTypes type) {
+        switch (type) {
+            case NTypes::N4:
+                return Slab<N4>::stats();
+            case NTypes::N16:
+                return Slab<N16>::stats();
+            case NTypes::N48:
+                return Slab<N48>::stats();
+            case NTypes::N256:
+                return Slab<N256>::stats();
+        }
+        return SlabStats();
+    }
+
     void N::deleteNode(N *node) {
         if (N::isLeaf(node)) {
-            void * leaf = reinterpret_cast<void *>(N::getLeaf(node));
-            if(leaf) {
-                delete leaf;
-            }
+            //the records behind the TIDs belong to the user of the tree
             return;
         }
         switch (node->getType()) {
@@ -11,6 +11,7 @@
 #include <string.h>
 #include "Key.h"
 #include "Epoche.h"
+#include "Slab.h"
 
 using TID = uint64_t;
 
@@ -133,6 +134,11 @@ namespace ART_OLC {
 
         static void deleteNode(N *node);
 
+        //deleter of obsolete nodes for the epoche
+        static void freeNode(void *node);
+
+        static SlabStats slabStats(NTypes type);
+
         static std::tuple<N *, uint8_t> getSecondChild(N *node, const uint8_t k);
 
         template<typename curN, typename biggerN>
@@ -165,6 +171,11 @@ namespace ART_OLC {
         N4(const uint8_t *prefix, uint32_t prefixLength, uint32_t matchLevel) : N(NTypes::N4, prefix,
                                                              prefixLength, matchLevel) {}
 
+        //nodes come from the slab of their type
+        static void *operator new(std::size_t size);
+
+        static void operator delete(void *node);
+
         void insert(uint8_t key, N *n);
 
         template<class NODE>
@@ -236,6 +247,10 @@ namespace ART_OLC {
             memset(children, 0, sizeof(children));
         }
 
+        static void *operator new(std::size_t size);
+
+        static void operator delete(void *node);
+
         void insert(uint8_t key, N *n);
 
         template<class NODE>
@@ -275,6 +290,10 @@ namespace ART_OLC {
             memset(children, 0, sizeof(children));
         }
 
+        static void *operator new(std::size_t size);
+
+        static void operator delete(void *node);
+
         void insert(uint8_t key, N *n);
 
         template<class NODE>
@@ -311,6 +330,10 @@ namespace ART_OLC {
             memset(children, '\0', sizeof(children));
         }
 
+        static void *operator new(std::size_t size);
+
+        static void operator delete(void *node);
+
         void insert(uint8_t key, N *val);
 
         template<class NODE>
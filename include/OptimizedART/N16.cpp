@@ -6,6 +6,14 @@
 
 namespace ART_OLC {
 
+    void *N16::operator new(std::size_t size) {
+        return Slab<N16>::allocate();
+    }
+
+    void N16::operator delete(void *node) {
+        Slab<N16>::free(node);
+    }
+
     bool N16::isFull() const {
         return count == 16;
     }
@@ -103,7 +111,14 @@ namespace ART_OLC {
         bool needRestart = false;
         uint64_t v;
         v = readLockOrRestart(needRestart);
-        if (needRestart) goto restart;
+        if (needRestart) {
+            // an obsolete node doesn't change anymore, the caller restarts from the root
+            if (isObsolete(v)) {
+                childrenCount = 0;
+                return v;
+            }
+            goto restart;
+        }
         childrenCount = 0;
         auto startPos = getChildPos(start);
         auto endPos = getChildPos(end);
@@ -125,7 +140,10 @@ namespace ART_OLC {
     long N16::size() {
         long size = 0;
         for(int i = 0; i < 16; i++) {
-            size += N::size(children[i]);
+            // entries past count are left over from removes
+            if (i < count) {
+                size += N::size(children[i]);
+            }
             size += sizeof(children[i]);
             size += sizeof(keys[i]);
         }
@@ -5,6 +5,14 @@
 
 namespace ART_OLC {
 
+    void *N256::operator new(std::size_t size) {
+        return Slab<N256>::allocate();
+    }
+
+    void N256::operator delete(void *node) {
+        Slab<N256>::free(node);
+    }
+
     bool N256::isFull() const {
         return false;
     }
@@ -89,7 +97,14 @@ namespace ART_OLC {
         bool needRestart = false;
         uint64_t v;
         v = readLockOrRestart(needRestart);
-        if (needRestart) goto restart;
+        if (needRestart) {
+            // an obsolete node doesn't change anymore, the caller restarts from the root
+            if (isObsolete(v)) {
+                childrenCount = 0;
+                return v;
+            }
+            goto restart;
+        }
         childrenCount = 0;
         for (unsigned i = start; i <= end; i++) {
             if (this->children[i] != nullptr) {
@@ -4,6 +4,14 @@
 
 namespace ART_OLC {
 
+    void *N4::operator new(std::size_t size) {
+        return Slab<N4>::allocate();
+    }
+
+    void N4::operator delete(void *node) {
+        Slab<N4>::free(node);
+    }
+
     void N4::deleteChildren() {
         for (uint32_t i = 0; i < count; ++i) {
             N::deleteChildren(children[i]);
@@ -105,7 +113,14 @@ namespace ART_OLC {
         bool needRestart = false;
         uint64_t v;
         v = readLockOrRestart(needRestart);
-        if (needRestart) goto restart;
+        if (needRestart) {
+            // an obsolete node doesn't change anymore, the caller restarts from the root
+            if (isObsolete(v)) {
+                childrenCount = 0;
+                return v;
+            }
+            goto restart;
+        }
         childrenCount = 0;
         for (uint32_t i = 0; i < count; ++i) {
             if (this->keys[i] >= start && this->keys[i] <= end) {
@@ -121,7 +136,10 @@ namespace ART_OLC {
     long N4::size() {
         long size = 0;
         for(int i = 0; i < 4; i++) {
-            size += N::size(children[i]);
+            // entries past count are left over from removes
+            if (i < count) {
+                size += N::size(children[i]);
+            }
             size += sizeof(children[i]);
             size += sizeof(keys[i]);
         }
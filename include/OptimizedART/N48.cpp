@@ -4,6 +4,14 @@
 
 namespace ART_OLC {
 
+    void *N48::operator new(std::size_t size) {
+        return Slab<N48>::allocate();
+    }
+
+    void N48::operator delete(void *node) {
+        Slab<N48>::free(node);
+    }
+
     bool N48::isFull() const {
         return count == 48;
     }
@@ -92,7 +100,14 @@ namespace ART_OLC {
         bool needRestart = false;
         uint64_t v;
         v = readLockOrRestart(needRestart);
-        if (needRestart) goto restart;
+        if (needRestart) {
+            // an obsolete node doesn't change anymore, the caller restarts from the root
+            if (isObsolete(v)) {
+                childrenCount = 0;
+                return v;
+            }
+            goto restart;
+        }
         childrenCount = 0;
         for (unsigned i = start; i <= end; i++) {
             if (this->childIndex[i] != emptyMarker) {
@@ -0,0 +1,231 @@
+#ifndef ART_SLAB_H
+#define ART_SLAB_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ART {
+
+    constexpr std::size_t SLAB_CHUNK_SIZE = 1u << 16; // bytes a thread takes at once from the system
+    constexpr std::size_t SLAB_THREAD_FREE = 256;     // freed objects moved from a thread to the shared list at once
+
+    struct SlabStats {
+        std::size_t live = 0;     // allocated and not freed yet
+        std::size_t free = 0;     // freed and waiting to be reused
+        std::size_t reserved = 0; // bytes of the chunks taken from the system
+    };
+
+    /*
+     * Allocator for the objects of one type, e.g. a node type of the tree.
+     * Every thread allocates from a free list and a chunk of its own, without locking. A thread that
+     * frees many objects, like the one reclaiming an epoch, moves batches of them to a shared list
+     * which the other threads refill from. Chunks are never given back to the system.
+     */
+    template<typename T>
+    class Slab {
+        union Block {
+            Block *next;
+            alignas(T) unsigned char object[sizeof(T)];
+        };
+
+        struct Batch {
+            Block *head;
+            std::size_t count;
+        };
+
+        struct ThreadCache {
+            Block *freeList = nullptr;
+            Block *next = nullptr; // unused part of the chunk
+            Block *end = nullptr;
+            // written by the owning thread only, read by stats()
+            std::atomic<std::size_t> freeCount{0};
+            std::atomic<std::size_t> allocated{0};
+            std::atomic<std::size_t> freed{0};
+        };
+
+        struct Shared {
+            std::mutex mutex;
+            std::vector<Batch> batches;
+            std::size_t batchedCount = 0;
+            std::vector<ThreadCache *> caches;
+            std::size_t allocated = 0; // of the threads that have exited
+            std::size_t freed = 0;
+            std::size_t reserved = 0;
+        };
+
+        struct Local {
+            ThreadCache *cache;
+            bool exited;
+        };
+
+        // returns the cache of the thread when it exits
+        struct Reaper {
+            ~Reaper() {
+                Local &l = local();
+                releaseCache(l.cache);
+                l.cache = nullptr;
+                l.exited = true;
+            }
+        };
+
+        static constexpr std::size_t chunkBlocks() {
+            return SLAB_CHUNK_SIZE / sizeof(Block) > 16 ? SLAB_CHUNK_SIZE / sizeof(Block) : 16;
+        }
+
+        // never destroyed, objects may be freed by destructors of static objects
+        static Shared &shared() {
+            static Shared *s = new Shared();
+            return *s;
+        }
+
+        static Local &local() {
+            thread_local Local l{nullptr, false};
+            return l;
+        }
+
+        // nullptr once the thread is exiting
+        static ThreadCache *threadCache() {
+            Local &l = local();
+            if (l.cache == nullptr && !l.exited) {
+                thread_local Reaper reaper;
+                (void) reaper;
+                l.cache = new ThreadCache();
+                Shared &s = shared();
+                std::lock_guard<std::mutex> guard(s.mutex);
+                s.caches.push_back(l.cache);
+            }
+            return l.cache;
+        }
+
+        static void releaseCache(ThreadCache *cache) {
+            if (cache == nullptr) {
+                return;
+            }
+            Shared &s = shared();
+            std::lock_guard<std::mutex> guard(s.mutex);
+            if (cache->freeList != nullptr) {
+                s.batches.push_back({cache->freeList, cache->freeCount.load(std::memory_order_relaxed)});
+                s.batchedCount += cache->freeCount.load(std::memory_order_relaxed);
+            }
+            s.allocated += cache->allocated.load(std::memory_order_relaxed);
+            s.freed += cache->freed.load(std::memory_order_relaxed);
+            for (auto it = s.caches.begin(); it != s.caches.end(); ++it) {
+                if (*it == cache) {
+                    s.caches.erase(it);
+                    break;
+                }
+            }
+            delete cache;
+        }
+
+        static void increment(std::atomic<std::size_t> &counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // takes a batch from the shared list or a new chunk
+        static Block *refill(ThreadCache *c) {
+            Shared &s = shared();
+            std::lock_guard<std::mutex> guard(s.mutex);
+            if (!s.batches.empty()) {
+                Batch batch = s.batches.back();
+                s.batches.pop_back();
+                s.batchedCount -= batch.count;
+                c->freeList = batch.head->next;
+                c->freeCount.store(batch.count - 1, std::memory_order_relaxed);
+                return batch.head;
+            }
+            c->next = static_cast<Block *>(::operator new(chunkBlocks() * sizeof(Block)));
+            c->end = c->next + chunkBlocks();
+            s.reserved += chunkBlocks() * sizeof(Block);
+            return c->next++;
+        }
+
+    public:
+        static void *allocate() {
+            ThreadCache *c = threadCache();
+            if (c == nullptr) {
+                Shared &s = shared();
+                std::lock_guard<std::mutex> guard(s.mutex);
+                s.allocated++;
+                if (s.batches.empty()) {
+                    s.reserved += sizeof(Block);
+                    return ::operator new(sizeof(Block));
+                }
+                Batch &batch = s.batches.back();
+                Block *b = batch.head;
+                batch.head = b->next;
+                s.batchedCount--;
+                if (--batch.count == 0) {
+                    s.batches.pop_back();
+                }
+                return b;
+            }
+            Block *b = c->freeList;
+            if (b != nullptr) {
+                c->freeList = b->next;
+                c->freeCount.store(c->freeCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+            } else if (c->next != c->end) {
+                b = c->next++;
+            } else {
+                b = refill(c);
+            }
+            increment(c->allocated);
+            return b;
+        }
+
+        static void free(void *object) {
+            Block *b = static_cast<Block *>(object);
+            ThreadCache *c = threadCache();
+            if (c == nullptr) {
+                Shared &s = shared();
+                std::lock_guard<std::mutex> guard(s.mutex);
+                b->next = nullptr;
+                s.batches.push_back({b, 1});
+                s.batchedCount++;
+                s.freed++;
+                return;
+            }
+            b->next = c->freeList;
+            c->freeList = b;
+            std::size_t freeCount = c->freeCount.load(std::memory_order_relaxed) + 1;
+            if (freeCount > 2 * SLAB_THREAD_FREE) {
+                // keep the last freed objects, they are likely still in the cache
+                Block *last = c->freeList;
+                for (std::size_t i = 1; i < SLAB_THREAD_FREE; i++) {
+                    last = last->next;
+                }
+                Shared &s = shared();
+                std::lock_guard<std::mutex> guard(s.mutex);
+                s.batches.push_back({last->next, freeCount - SLAB_THREAD_FREE});
+                s.batchedCount += freeCount - SLAB_THREAD_FREE;
+                last->next = nullptr;
+                freeCount = SLAB_THREAD_FREE;
+            }
+            c->freeCount.store(freeCount, std::memory_order_relaxed);
+            increment(c->freed);
+        }
+
+        static SlabStats stats() {
+            Shared &s = shared();
+            std::lock_guard<std::mutex> guard(s.mutex);
+            std::size_t allocated = s.allocated, freed = s.freed;
+            SlabStats stats;
+            stats.free = s.batchedCount;
+            stats.reserved = s.reserved;
+            for (ThreadCache *c : s.caches) {
+                allocated += c->allocated.load(std::memory_order_relaxed);
+                freed += c->freed.load(std::memory_order_relaxed);
+                stats.free += c->freeCount.load(std::memory_order_relaxed);
+            }
+            // counters of different threads are read at different times
+            stats.live = allocated > freed ? allocated - freed : 0;
+            return stats;
+        }
+    };
+
+}
+
+#endif //ART_SLAB_H
@@ -12,11 +12,15 @@
 
 namespace ART_OLC {
 
-    Tree::Tree(LoadKeyFunction loadKey) : root(new N256( nullptr, 0, 0)), loadKey(loadKey) {
+    Tree::Tree(LoadKeyFunction loadKey, FreeLeafFunction freeLeaf) : root(new N256( nullptr, 0, 0)), loadKey(loadKey),
+                                                                     freeLeaf(freeLeaf) {
 
     }
 
     Tree::~Tree() {
+        if (freeLeaf != nullptr) {
+            forEachLeaf(root, [this](TID tid) { freeLeaf(reinterpret_cast<void *>(tid)); });
+        }
         N::deleteChildren(root);
         N::deleteNode(root);
     }
@@ -25,6 +29,25 @@ namespace ART_OLC {
         return ThreadInfo(this->epoche);
     }
 
+    void Tree::freeLeafLater(TID tid, ThreadInfo &epocheInfo) {
+        if (freeLeaf != nullptr) {
+            epoche.markForDeletion(reinterpret_cast<void *>(tid), freeLeaf, epocheInfo);
+        }
+    }
+
+    void Tree::forEachLeaf(N *node, const std::function<void(TID)> &fn) {
+        if (N::isLeaf(node)) {
+            fn(N::getLeaf(node));
+            return;
+        }
+        std::tuple<uint8_t, N *> children[256];
+        uint32_t childrenCount = 0;
+        N::getChildren(node, 0, 255, children, childrenCount);
+        for (uint32_t i = 0; i < childrenCount; i++) {
+            forEachLeaf(std::get<1>(children[i]), fn);
+        }
+    }
+
     TID Tree::lookup(const Key &k, ThreadInfo &threadEpocheInfo) const {
         EpocheGuardReadonly epocheGuard(threadEpocheInfo);
         restart:
@@ -87,8 +110,7 @@ namespace ART_OLC {
         bool needRestart = false;
 
         N *parentNode = nullptr;
-        FastPointerBuffer::FastPointerItem pointer = fastPointerBuffer.getFastPointer(fastPointerIndex);
-        N *cur_node = pointer.fast_pointer;
+        N *cur_node = fastPointerBuffer.getFastPointer(fastPointerIndex);
 
 
         uint64_t v;
@@ -152,7 +174,9 @@ namespace ART_OLC {
         }
         EpocheGuard epocheGuard(threadEpocheInfo);
         TID toContinue = 0;
-        std::function<void(const N *)> copy = [&result, &resultSize, &resultsFound, &toContinue, &copy](const N *node) {
+        // set when the scan reaches a node replaced meanwhile, the scan then restarts from the root
+        bool obsolete = false;
+        std::function<void(const N *)> copy = [&result, &resultSize, &resultsFound, &toContinue, &obsolete, &copy](const N *node) {
             if (N::isLeaf(node)) {
                 if (resultsFound == resultSize) {
                     toContinue = N::getLeaf(node);
@@ -163,17 +187,21 @@ namespace ART_OLC {
             } else {
                 std::tuple<uint8_t, N *> children[256];
                 uint32_t childrenCount = 0;
-                N::getChildren(node, 0u, 255u, children, childrenCount);
+                uint64_t v = N::getChildren(node, 0u, 255u, children, childrenCount);
+                if (N::isObsolete(v)) {
+                    obsolete = true;
+                    return;
+                }
                 for (uint32_t i = 0; i < childrenCount; ++i) {
                     const N *n = std::get<1>(children[i]);
                     copy(n);
-                    if (toContinue != 0) {
+                    if (toContinue != 0 || obsolete) {
                         break;
                     }
                 }
             }
         };
-        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findStart = [&copy, &start, &findStart, &toContinue, this](
+        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findStart = [&copy, &start, &findStart, &toContinue, &obsolete, this](
                 N *node, uint8_t nodeK, uint32_t level, const N *parentNode, uint64_t vp) {
             if (N::isLeaf(node)) {
                 copy(node);
@@ -186,7 +214,13 @@ namespace ART_OLC {
                 readAgain:
                 bool needRestart = false;
                 v = node->readLockOrRestart(needRestart);
-                if (needRestart) goto readAgain;
+                if (needRestart) {
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        return;
+                    }
+                    goto readAgain;
+                }
 
                 prefixResult = checkPrefixCompare(node, start, 0, level, loadKey, needRestart);
                 if (needRestart) goto readAgain;
@@ -194,8 +228,16 @@ namespace ART_OLC {
                 parentNode->readUnlockOrRestart(vp, needRestart);
                 if (needRestart) {
                     readParentAgain:
+                    // readLockOrRestart() only ever sets the flag
+                    needRestart = false;
                     vp = parentNode->readLockOrRestart(needRestart);
-                    if (needRestart) goto readParentAgain;
+                    if (needRestart) {
+                        if (N::isObsolete(vp)) {
+                            obsolete = true;
+                            return;
+                        }
+                        goto readParentAgain;
+                    }
 
                     node = N::getChild(nodeK, parentNode);
 
@@ -224,6 +266,10 @@ namespace ART_OLC {
                     std::tuple<uint8_t, N *> children[256];
                     uint32_t childrenCount = 0;
                     v = N::getChildren(node, startLevel, 255, children, childrenCount);
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        break;
+                    }
                     for (uint32_t i = 0; i < childrenCount; ++i) {
                         const uint8_t k = std::get<0>(children[i]);
                         N *n = std::get<1>(children[i]);
@@ -232,7 +278,7 @@ namespace ART_OLC {
                         } else if (k > startLevel) {
                             copy(n);
                         }
-                        if (toContinue != 0) {
+                        if (toContinue != 0 || obsolete) {
                             break;
                         }
                     }
@@ -242,9 +288,11 @@ namespace ART_OLC {
                     break;
             }
         };
-        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findEnd = [&copy, &end, &toContinue, &findEnd, this](
+        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findEnd = [&copy, &end, &toContinue, &obsolete, &findEnd, this](
                 N *node, uint8_t nodeK, uint32_t level, const N *parentNode, uint64_t vp) {
             if (N::isLeaf(node)) {
+                // the leaf may still be within the end key, callers filter the result by key
+                copy(node);
                 return;
             }
             uint64_t v;
@@ -253,7 +301,13 @@ namespace ART_OLC {
                 readAgain:
                 bool needRestart = false;
                 v = node->readLockOrRestart(needRestart);
-                if (needRestart) goto readAgain;
+                if (needRestart) {
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        return;
+                    }
+                    goto readAgain;
+                }
 
                 prefixResult = checkPrefixCompare(node, end, 255, level, loadKey, needRestart);
                 if (needRestart) goto readAgain;
@@ -261,8 +315,16 @@ namespace ART_OLC {
                 parentNode->readUnlockOrRestart(vp, needRestart);
                 if (needRestart) {
                     readParentAgain:
+                    // readLockOrRestart() only ever sets the flag
+                    needRestart = false;
                     vp = parentNode->readLockOrRestart(needRestart);
-                    if (needRestart) goto readParentAgain;
+                    if (needRestart) {
+                        if (N::isObsolete(vp)) {
+                            obsolete = true;
+                            return;
+                        }
+                        goto readParentAgain;
+                    }
 
                     node = N::getChild(nodeK, parentNode);
 
@@ -289,6 +351,10 @@ namespace ART_OLC {
                     std::tuple<uint8_t, N *> children[256];
                     uint32_t childrenCount = 0;
                     v = N::getChildren(node, 0, endLevel, children, childrenCount);
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        break;
+                    }
                     for (uint32_t i = 0; i < childrenCount; ++i) {
                         const uint8_t k = std::get<0>(children[i]);
                         N *n = std::get<1>(children[i]);
@@ -297,7 +363,7 @@ namespace ART_OLC {
                         } else if (k < endLevel) {
                             copy(n);
                         }
-                        if (toContinue != 0) {
+                        if (toContinue != 0 || obsolete) {
                             break;
                         }
                     }
@@ -312,6 +378,8 @@ namespace ART_OLC {
         bool needRestart = false;
 
         resultsFound = 0;
+        toContinue = 0;
+        obsolete = false;
 
         uint32_t level = 0;
         N *node = nullptr;
@@ -351,6 +419,7 @@ namespace ART_OLC {
                         std::tuple<uint8_t, N *> children[256];
                         uint32_t childrenCount = 0;
                         v = N::getChildren(node, startLevel, endLevel, children, childrenCount);
+                        if (N::isObsolete(v)) goto restart;
                         for (uint32_t i = 0; i < childrenCount; ++i) {
                             const uint8_t k = std::get<0>(children[i]);
                             N *n = std::get<1>(children[i]);
@@ -361,7 +430,7 @@ namespace ART_OLC {
                             } else if (k == endLevel) {
                                 findEnd(n, k, level + 1, node, v);
                             }
-                            if (toContinue) {
+                            if (toContinue || obsolete) {
                                 break;
                             }
                         }
@@ -369,6 +438,13 @@ namespace ART_OLC {
                         nextNode = N::getChild(startLevel, node);
                         node->readUnlockOrRestart(v, needRestart);
                         if (needRestart) goto restart;
+                        if (nextNode == nullptr) {
+                            return false;
+                        }
+                        if (N::isLeaf(nextNode)) {
+                            copy(nextNode);
+                            break;
+                        }
                         level++;
                         continue;
                     }
@@ -377,6 +453,7 @@ namespace ART_OLC {
             }
             break;
         }
+        if (obsolete) goto restart;
         if (toContinue != 0) {
             loadKey(toContinue, continueKey);
             return true;
@@ -397,7 +474,9 @@ namespace ART_OLC {
         }
         EpocheGuard epocheGuard(threadEpocheInfo);
         TID toContinue = 0;
-        std::function<void(const N *)> copy = [&result, &resultSize, &resultsFound, &toContinue, &copy](const N *node) {
+        // set when the scan reaches a node replaced meanwhile, the scan then restarts from the root
+        bool obsolete = false;
+        std::function<void(const N *)> copy = [&result, &resultSize, &resultsFound, &toContinue, &obsolete, &copy](const N *node) {
             if (N::isLeaf(node)) {
                 if (resultsFound == resultSize) {
                     toContinue = N::getLeaf(node);
@@ -408,17 +487,21 @@ namespace ART_OLC {
             } else {
                 std::tuple<uint8_t, N *> children[256];
                 uint32_t childrenCount = 0;
-                N::getChildren(node, 0u, 255u, children, childrenCount);
+                uint64_t v = N::getChildren(node, 0u, 255u, children, childrenCount);
+                if (N::isObsolete(v)) {
+                    obsolete = true;
+                    return;
+                }
                 for (uint32_t i = 0; i < childrenCount; ++i) {
                     const N *n = std::get<1>(children[i]);
                     copy(n);
-                    if (toContinue != 0) {
+                    if (toContinue != 0 || obsolete) {
                         break;
                     }
                 }
             }
         };
-        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findStart = [&copy, &start, &findStart, &toContinue, this](
+        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findStart = [&copy, &start, &findStart, &toContinue, &obsolete, this](
                 N *node, uint8_t nodeK, uint32_t level, const N *parentNode, uint64_t vp) {
             if (N::isLeaf(node)) {
                 copy(node);
@@ -431,7 +514,13 @@ namespace ART_OLC {
                 readAgain:
                 bool needRestart = false;
                 v = node->readLockOrRestart(needRestart);
-                if (needRestart) goto readAgain;
+                if (needRestart) {
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        return;
+                    }
+                    goto readAgain;
+                }
 
                 prefixResult = checkPrefixCompare(node, start, 0, level, loadKey, needRestart);
                 if (needRestart) goto readAgain;
@@ -439,8 +528,16 @@ namespace ART_OLC {
                 parentNode->readUnlockOrRestart(vp, needRestart);
                 if (needRestart) {
                     readParentAgain:
+                    // readLockOrRestart() only ever sets the flag
+                    needRestart = false;
                     vp = parentNode->readLockOrRestart(needRestart);
-                    if (needRestart) goto readParentAgain;
+                    if (needRestart) {
+                        if (N::isObsolete(vp)) {
+                            obsolete = true;
+                            return;
+                        }
+                        goto readParentAgain;
+                    }
 
                     node = N::getChild(nodeK, parentNode);
 
@@ -469,6 +566,10 @@ namespace ART_OLC {
                     std::tuple<uint8_t, N *> children[256];
                     uint32_t childrenCount = 0;
                     v = N::getChildren(node, startLevel, 255, children, childrenCount);
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        break;
+                    }
                     for (uint32_t i = 0; i < childrenCount; ++i) {
                         const uint8_t k = std::get<0>(children[i]);
                         N *n = std::get<1>(children[i]);
@@ -477,7 +578,7 @@ namespace ART_OLC {
                         } else if (k > startLevel) {
                             copy(n);
                         }
-                        if (toContinue != 0) {
+                        if (toContinue != 0 || obsolete) {
                             break;
                         }
                     }
@@ -487,9 +588,11 @@ namespace ART_OLC {
                     break;
             }
         };
-        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findEnd = [&copy, &end, &toContinue, &findEnd, this](
+        std::function<void(N *, uint8_t, uint32_t, const N *, uint64_t)> findEnd = [&copy, &end, &toContinue, &obsolete, &findEnd, this](
                 N *node, uint8_t nodeK, uint32_t level, const N *parentNode, uint64_t vp) {
             if (N::isLeaf(node)) {
+                // the leaf may still be within the end key, callers filter the result by key
+                copy(node);
                 return;
             }
             uint64_t v;
@@ -498,7 +601,13 @@ namespace ART_OLC {
                 readAgain:
                 bool needRestart = false;
                 v = node->readLockOrRestart(needRestart);
-                if (needRestart) goto readAgain;
+                if (needRestart) {
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        return;
+                    }
+                    goto readAgain;
+                }
 
                 prefixResult = checkPrefixCompare(node, end, 255, level, loadKey, needRestart);
                 if (needRestart) goto readAgain;
@@ -506,8 +615,16 @@ namespace ART_OLC {
                 parentNode->readUnlockOrRestart(vp, needRestart);
                 if (needRestart) {
                     readParentAgain:
+                    // readLockOrRestart() only ever sets the flag
+                    needRestart = false;
                     vp = parentNode->readLockOrRestart(needRestart);
-                    if (needRestart) goto readParentAgain;
+                    if (needRestart) {
+                        if (N::isObsolete(vp)) {
+                            obsolete = true;
+                            return;
+                        }
+                        goto readParentAgain;
+                    }
 
                     node = N::getChild(nodeK, parentNode);
 
@@ -534,6 +651,10 @@ namespace ART_OLC {
                     std::tuple<uint8_t, N *> children[256];
                     uint32_t childrenCount = 0;
                     v = N::getChildren(node, 0, endLevel, children, childrenCount);
+                    if (N::isObsolete(v)) {
+                        obsolete = true;
+                        break;
+                    }
                     for (uint32_t i = 0; i < childrenCount; ++i) {
                         const uint8_t k = std::get<0>(children[i]);
                         N *n = std::get<1>(children[i]);
@@ -542,7 +663,7 @@ namespace ART_OLC {
                         } else if (k < endLevel) {
                             copy(n);
                         }
-                        if (toContinue != 0) {
+                        if (toContinue != 0 || obsolete) {
                             break;
                         }
                     }
@@ -557,6 +678,8 @@ namespace ART_OLC {
         bool needRestart = false;
 
         resultsFound = 0;
+        toContinue = 0;
+        obsolete = false;
 
 
         int ret = 0;
@@ -572,6 +695,7 @@ namespace ART_OLC {
         std::tuple<uint8_t, N *> children[256];
         uint32_t childrenCount = 0;
         v = N::getChildren(node, startLevel, endLevel, children, childrenCount);
+        if (N::isObsolete(v)) goto restart;
         for (uint32_t i = 0; i < childrenCount; ++i) {
             const uint8_t k = std::get<0>(children[i]);
             N *n = std::get<1>(children[i]);
@@ -582,10 +706,11 @@ namespace ART_OLC {
             } else if (k == endLevel) {
                 findEnd(n, k, level + 1, node, v);
             }
-            if (toContinue) {
+            if (toContinue || obsolete) {
                 break;
             }
         }
+        if (obsolete) goto restart;
 
         if (toContinue != 0) {
             loadKey(toContinue, continueKey);
@@ -658,6 +783,9 @@ namespace ART_OLC {
 
                     node->setMatchLevel(level + node_prefix - node->getPrefixLength());
 
+                    // keys of a fast pointer range may now branch off above node
+                    fastPointerBuffer.replaceFastPointer(node, newNode);
+
                     node->writeUnlock();
 
                     return;
@@ -676,17 +804,7 @@ namespace ART_OLC {
                 if (needRestart) goto restart;
 
                 if(new_node != nullptr){
-                    retry:
-                    auto v = node->readLockOrRestart(needRestart);
-                    if(needRestart) goto retry;
-
-                    int pointer_index = fastPointerBuffer.getFastPointerIndex(node);
-
-                    node->upgradeToWriteLockOrRestart(v, needRestart);
-                    if(needRestart) goto retry;
-
-                    fastPointerBuffer.updateFastPointerWithIndex(pointer_index, new_node);
-                    node->writeUnlock();
+                    fastPointerBuffer.replaceFastPointer(node, new_node);
 
                     epocheInfo.getEpoche().markNodeForDeletion(node, epocheInfo);
                 }
@@ -732,7 +850,7 @@ namespace ART_OLC {
         restart:
         bool needRestart = false;
 
-        FastPointerBuffer::FastPointerItem pointer = fastPointerBuffer.getFastPointer(fastPointerIndex);
+        N *fastPointer = fastPointerBuffer.getFastPointer(fastPointerIndex);
         N *node = nullptr;  //current node
         N *nextNode = root; //next node
         N *parentNode = nullptr;    //parent node
@@ -781,12 +899,15 @@ namespace ART_OLC {
                     node->setPrefix(remainingPrefix,
                                     node->getPrefixLength() - ((nextLevel - level) + 1));
 
-                    if(node == pointer.fast_pointer) {
+                    if(node == fastPointer) {
                         fastPointerIndex = fastPointerBuffer.insertFastPointer(newNode);
                     }
 
                     node->setMatchLevel(level + node_prefix - node->getPrefixLength());
 
+                    // keys of a fast pointer range may now branch off above node
+                    fastPointerBuffer.replaceFastPointer(node, newNode);
+
                     node->writeUnlock();
 
                     return;
@@ -806,17 +927,7 @@ namespace ART_OLC {
                 if (needRestart) goto restart;
 
                 if(new_node != nullptr){
-                    retry:
-                    auto v = node->readLockOrRestart(needRestart);
-                    if(needRestart) goto retry;
-
-                    int pointer_index = fastPointerBuffer.getFastPointerIndex(node);
-
-                    node->upgradeToWriteLockOrRestart(v, needRestart);
-                    if(needRestart) goto retry;
-
-                    fastPointerBuffer.updateFastPointerWithIndex(pointer_index, new_node);
-                    node->writeUnlock();
+                    fastPointerBuffer.replaceFastPointer(node, new_node);
 
                     epocheInfo.getEpoche().markNodeForDeletion(node, epocheInfo);
                 }
@@ -856,6 +967,91 @@ namespace ART_OLC {
 
     }
 
+    void Tree::bulkBuildSorted(const uint8_t *keys, uint32_t keyLength, const TID *tids, std::size_t n) {
+        ThreadInfo threadInfo = getThreadInfo();
+        Key k;
+        std::size_t first = 0;
+        for (std::size_t i = 1; i <= n; i++) {
+            if (i < n && keys[i * keyLength] == keys[first * keyLength]) {
+                continue;
+            }
+            const uint8_t rootKey = keys[first * keyLength];
+            if (N::getChild(rootKey, root) == nullptr) {
+                N *subtree = bulkBuildNode(keys + first * keyLength, keyLength, tids + first, i - first, 1);
+                bool needRestart;
+                do {
+                    needRestart = false;
+                    root->writeLockOrRestart(needRestart);
+                } while (needRestart);
+                static_cast<N256 *>(root)->insert(rootKey, subtree);
+                root->writeUnlock();
+            } else {
+                for (std::size_t j = first; j < i; j++) {
+                    k.set(reinterpret_cast<const char *>(keys + j * keyLength), keyLength);
+                    insert(k, tids[j], threadInfo);
+                }
+            }
+            first = i;
+        }
+    }
+
+    N *Tree::bulkBuildNode(const uint8_t *keys, uint32_t keyLength, const TID *tids, std::size_t n, uint32_t level) {
+        if (n == 1) {
+            return N::setLeaf(tids[0]);
+        }
+        //the keys are sorted, the prefix of the first and the last key is shared by all of them
+        const uint8_t *last = keys + (n - 1) * keyLength;
+        uint32_t prefixLength = 0;
+        while (keys[level + prefixLength] == last[level + prefixLength]) {
+            prefixLength++;
+        }
+        const uint32_t childLevel = level + prefixLength;
+        uint32_t childrenCount = 1;
+        for (std::size_t i = 1; i < n; i++) {
+            if (keys[i * keyLength + childLevel] != keys[(i - 1) * keyLength + childLevel]) {
+                childrenCount++;
+            }
+        }
+
+        //the smallest node type that holds all children
+        const uint8_t *prefix = keys + level;
+        N *node;
+        if (childrenCount <= 4) {
+            node = new N4(prefix, prefixLength, level);
+        } else if (childrenCount <= 16) {
+            node = new N16(prefix, prefixLength, level);
+        } else if (childrenCount <= 48) {
+            node = new N48(prefix, prefixLength, level);
+        } else {
+            node = new N256(prefix, prefixLength, level);
+        }
+
+        std::size_t first = 0;
+        for (std::size_t i = 1; i <= n; i++) {
+            if (i < n && keys[i * keyLength + childLevel] == keys[first * keyLength + childLevel]) {
+                continue;
+            }
+            const uint8_t key = keys[first * keyLength + childLevel];
+            N *child = bulkBuildNode(keys + first * keyLength, keyLength, tids + first, i - first, childLevel + 1);
+            switch (node->getType()) {
+                case NTypes::N4:
+                    static_cast<N4 *>(node)->insert(key, child);
+                    break;
+                case NTypes::N16:
+                    static_cast<N16 *>(node)->insert(key, child);
+                    break;
+                case NTypes::N48:
+                    static_cast<N48 *>(node)->insert(key, child);
+                    break;
+                case NTypes::N256:
+                    static_cast<N256 *>(node)->insert(key, child);
+                    break;
+            }
+            first = i;
+        }
+        return node;
+    }
+
     bool Tree::update(const Key &k, TID tid, ThreadInfo &threadEpocheInfo) {
         EpocheGuard epocheGuard(threadEpocheInfo);
         restart:
@@ -876,6 +1072,12 @@ namespace ART_OLC {
             auto v = node->readLockOrRestart(needRestart);
             if (needRestart) goto restart;
 
+            // level only fits node if the parent did not change meanwhile, e.g. merge its prefix into node
+            if (parentNode != nullptr) {
+                parentNode->checkOrRestart(parentVersion, needRestart);
+                if (needRestart) goto restart;
+            }
+
             switch (checkPrefix(node, k, level)) { // increases level
                 case CheckPrefixResult::NoMatch:
                     node->readUnlockOrRestart(v, needRestart);
@@ -914,11 +1116,13 @@ namespace ART_OLC {
                             if (checkKey(old_tid, k) == old_tid) {
                                 N::change(node, k[level], N::setLeaf(tid));
                                 node->writeUnlock();
+                                freeLeafLater(old_tid, threadEpocheInfo);
                                 return true;
                             }
                         }
                         N::change(node, k[level], N::setLeaf(tid));
                         node->writeUnlock();
+                        freeLeafLater(old_tid, threadEpocheInfo);
                         return true;
                     }
                     level++;
@@ -947,6 +1151,12 @@ namespace ART_OLC {
             auto v = node->readLockOrRestart(needRestart);
             if (needRestart) goto restart;
 
+            // level only fits node if the parent did not change meanwhile, e.g. merge its prefix into node
+            if (parentNode != nullptr) {
+                parentNode->checkOrRestart(parentVersion, needRestart);
+                if (needRestart) goto restart;
+            }
+
             switch (checkPrefix(node, k, level)) { // increases level
                 case CheckPrefixResult::NoMatch:
                     node->readUnlockOrRestart(v, needRestart);
@@ -967,6 +1177,13 @@ namespace ART_OLC {
                         return;
                     }
                     if (N::isLeaf(nextNode)) {
+                        TID leafTid = N::getLeaf(nextNode);
+                        if (checkKey(leafTid, k) != leafTid) {
+                            // the leaf of another key sharing the path, k is not in the tree
+                            node->readUnlockOrRestart(v, needRestart);
+                            if (needRestart) goto restart;
+                            return;
+                        }
                         assert(parentNode == nullptr || node->getCount() != 1);
                         if (node->getCount() == 2 && parentNode != nullptr) {
                             parentNode->upgradeToWriteLockOrRestart(parentVersion, needRestart);
@@ -984,6 +1201,7 @@ namespace ART_OLC {
                             if (N::isLeaf(secondNodeN)) {
                                 //N::remove(node, k[level]); not necessary
                                 N::change(parentNode, parentKey, secondNodeN);
+                                fastPointerBuffer.replaceFastPointer(node, parentNode);
 
                                 parentNode->writeUnlock();
                                 node->writeUnlockObsolete();
@@ -998,6 +1216,7 @@ namespace ART_OLC {
 
                                 //N::remove(node, k[level]); not necessary
                                 N::change(parentNode, parentKey, secondNodeN);
+                                fastPointerBuffer.replaceFastPointer(node, parentNode);
                                 parentNode->writeUnlock();
 
                                 secondNodeN->addPrefixBefore(node, secondNodeK);
@@ -1007,9 +1226,15 @@ namespace ART_OLC {
                                 this->epoche.markNodeForDeletion(node, threadInfo);
                             }
                         } else {
-                            N::removeAndUnlock(node, v, k[level], parentNode, parentVersion, parentKey, needRestart, threadInfo);
+                            N* new_node = N::removeAndUnlock(node, v, k[level], parentNode, parentVersion, parentKey, needRestart, threadInfo);
                             if (needRestart) goto restart;
+
+                            if(new_node != nullptr){
+                                fastPointerBuffer.replaceFastPointer(node, new_node);
+                                threadInfo.getEpoche().markNodeForDeletion(node, threadInfo);
+                            }
                         }
+                        freeLeafLater(leafTid, threadInfo);
                         return;
                     }
                     level++;
@@ -1024,7 +1249,6 @@ namespace ART_OLC {
         restart:
         bool needRestart = false;
 
-        FastPointerBuffer::FastPointerItem pointer = fastPointerBuffer.getFastPointer(fastPointerIndex);
         N *node = nullptr;
         N *nextNode = root;
         N *parentNode = nullptr;
@@ -1039,6 +1263,12 @@ namespace ART_OLC {
             auto v = node->readLockOrRestart(needRestart);
             if (needRestart) goto restart;
 
+            // level only fits node if the parent did not change meanwhile, e.g. merge its prefix into node
+            if (parentNode != nullptr) {
+                parentNode->checkOrRestart(parentVersion, needRestart);
+                if (needRestart) goto restart;
+            }
+
             switch (checkPrefix(node, k, level)) { // increases level
                 case CheckPrefixResult::NoMatch:
                     node->readUnlockOrRestart(v, needRestart);
@@ -1059,6 +1289,13 @@ namespace ART_OLC {
                         return;
                     }
                     if (N::isLeaf(nextNode)) {
+                        TID leafTid = N::getLeaf(nextNode);
+                        if (checkKey(leafTid, k) != leafTid) {
+                            // the leaf of another key sharing the path, k is not in the tree
+                            node->readUnlockOrRestart(v, needRestart);
+                            if (needRestart) goto restart;
+                            return;
+                        }
                         assert(parentNode == nullptr || node->getCount() != 1);
                         if (node->getCount() == 2 && parentNode != nullptr) {
                             parentNode->upgradeToWriteLockOrRestart(parentVersion, needRestart);
@@ -1076,6 +1313,7 @@ namespace ART_OLC {
                             if (N::isLeaf(secondNodeN)) {
                                 //N::remove(node, k[level]); not necessary
                                 N::change(parentNode, parentKey, secondNodeN);
+                                fastPointerBuffer.replaceFastPointer(node, parentNode);
 
                                 parentNode->writeUnlock();
                                 node->writeUnlockObsolete();
@@ -1090,6 +1328,7 @@ namespace ART_OLC {
 
                                 //N::remove(node, k[level]); not necessary
                                 N::change(parentNode, parentKey, secondNodeN);
+                                fastPointerBuffer.replaceFastPointer(node, parentNode);
                                 parentNode->writeUnlock();
 
                                 secondNodeN->addPrefixBefore(node, secondNodeK);
@@ -1104,23 +1343,12 @@ namespace ART_OLC {
                             if (needRestart) goto restart;
 
                             if(new_node != nullptr){
-                                retry:
-                                auto v = node->readLockOrRestart(needRestart);
-                                if(needRestart) goto retry;
-
-                                int pointer_index = fastPointerBuffer.getFastPointerIndex(node);
-
-                                node->upgradeToWriteLockOrRestart(v, needRestart);
-                                if(needRestart) goto retry;
-
-                                fastPointerBuffer.updateFastPointerWithIndex(pointer_index, new_node);
-                                node->writeUnlock();
-
+                                // the shrunk node is obsolete, so it can not be locked again
+                                fastPointerBuffer.replaceFastPointer(node, new_node);
                                 epocheInfo.getEpoche().markNodeForDeletion(node, epocheInfo);
                             }
-
-                            return;
                         }
+                        freeLeafLater(leafTid, epocheInfo);
                         return;
                     }
                     level++;
@@ -1325,17 +1553,19 @@ namespace ART_OLC {
 
     inline typename Tree::CheckPrefixResult Tree::checkPrefix(N *n, const Key &k, uint32_t &level) {
         if (n->hasPrefix()) {
-            if (k.getKeyLen() <= level + n->getPrefixLength()) {
+            // read once, a writer may change the prefix of the unlocked node meanwhile
+            uint32_t prefixLength = n->getPrefixLength();
+            if (k.getKeyLen() <= level + prefixLength) {
                 return CheckPrefixResult::NoMatch;
             }
-            for (uint32_t i = 0; i < std::min(n->getPrefixLength(), maxStoredPrefixLength); ++i) {
+            for (uint32_t i = 0; i < std::min(prefixLength, maxStoredPrefixLength); ++i) {
                 if (n->getPrefix()[i] != k[level]) {
                     return CheckPrefixResult::NoMatch;
                 }
                 ++level;
             }
-            if (n->getPrefixLength() > maxStoredPrefixLength) {
-                level = level + (n->getPrefixLength() - maxStoredPrefixLength);
+            if (prefixLength > maxStoredPrefixLength) {
+                level = level + (prefixLength - maxStoredPrefixLength);
                 return CheckPrefixResult::OptimisticMatch;
             }
         }
@@ -1348,8 +1578,15 @@ namespace ART_OLC {
                                                                              LoadKeyFunction loadKey, bool &needRestart) {
         if (n->hasPrefix()) {
             uint32_t prevLevel = level;
+            // the node is not locked, a writer may change the prefix meanwhile and the caller's version check
+            // catches that, but the prefix length must stay the same for the copies below
+            uint32_t prefixLength = n->getPrefixLength();
+            if (level + prefixLength >= k.getKeyLen()) {
+                needRestart = true;
+                return CheckPrefixPessimisticResult::Match;
+            }
             Key kt;
-            for (uint32_t i = 0; i < n->getPrefixLength(); ++i) {
+            for (uint32_t i = 0; i < prefixLength; ++i) {
                 if (i == maxStoredPrefixLength) {       //overflow goto next layer
                     auto anyTID = N::getAnyChildTid(n, needRestart);
                     if (needRestart) return CheckPrefixPessimisticResult::Match;
@@ -1358,16 +1595,16 @@ namespace ART_OLC {
                 uint8_t curKey = i >= maxStoredPrefixLength ? kt[level] : n->getPrefix()[i];
                 if (curKey != k[level]) {
                     nonMatchingKey = curKey;
-                    if (n->getPrefixLength() > maxStoredPrefixLength) {
+                    if (prefixLength > maxStoredPrefixLength) {
                         if (i < maxStoredPrefixLength) {
                             auto anyTID = N::getAnyChildTid(n, needRestart);
                             if (needRestart) return CheckPrefixPessimisticResult::Match;
                             loadKey(anyTID, kt);
                         }
-                        memcpy(nonMatchingPrefix, &kt[0] + level + 1, std::min((n->getPrefixLength() - (level - prevLevel) - 1),
+                        memcpy(nonMatchingPrefix, &kt[0] + level + 1, std::min((prefixLength - (level - prevLevel) - 1),
                                                                                maxStoredPrefixLength));
                     } else {
-                        memcpy(nonMatchingPrefix, n->getPrefix() + i + 1, n->getPrefixLength() - i - 1);
+                        memcpy(nonMatchingPrefix, n->getPrefix() + i + 1, prefixLength - i - 1);
                     }
                     return CheckPrefixPessimisticResult::NoMatch;
                 }
@@ -1431,7 +1668,18 @@ namespace ART_OLC {
         return size + sizeof(root);
     }
 
-    void Tree::makeFastRoot(){
-        fastPointerBuffer.insertFastPointer(root);
+    std::size_t Tree::leafCount() {
+        std::size_t count = 0;
+        forEachLeaf(root, [&count](TID) { count++; });
+        return count;
+    }
+
+    int Tree::makeFastRoot(){
+        return fastPointerBuffer.insertFastPointer(root);
+    }
+
+    uint32_t Tree::fastPointerLevel(int fastPointerIndex, ThreadInfo &threadEpocheInfo) const {
+        EpocheGuardReadonly epocheGuard(threadEpocheInfo);
+        return fastPointerBuffer.getFastPointer(fastPointerIndex)->getMatchLevel();
     }
 }
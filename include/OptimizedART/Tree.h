@@ -4,6 +4,7 @@
 
 #ifndef ART_OPTIMISTICLOCK_COUPLING_N_H
 #define ART_OPTIMISTICLOCK_COUPLING_N_H
+#include <functional>
 #include "N.h"
 #include "FastPointerBuffer.h"
 
@@ -16,15 +17,26 @@ namespace ART_OLC {
     public:
         using LoadKeyFunction = void (*)(TID tid, Key &key);
 
+        //frees the record behind a TID, records of removed keys are freed when their epoch is over
+        using FreeLeafFunction = Deleter;
+
         N *const root;
 
     private:
 
         TID checkKey(const TID tid, const Key &k) const;
 
+        static N *bulkBuildNode(const uint8_t *keys, uint32_t keyLength, const TID *tids, std::size_t n, uint32_t level);
+
         LoadKeyFunction loadKey;
 
-        Epoche epoche{128};
+        FreeLeafFunction freeLeaf;
+
+        Epoche epoche{128, N::freeNode};
+
+        void freeLeafLater(TID tid, ThreadInfo &epocheInfo);
+
+        static void forEachLeaf(N *node, const std::function<void(TID)> &fn);
 
         FastPointerBuffer fastPointerBuffer;
 
@@ -63,11 +75,11 @@ namespace ART_OLC {
 
     public:
 
-        Tree(LoadKeyFunction loadKey);
+        Tree(LoadKeyFunction loadKey, FreeLeafFunction freeLeaf = nullptr);
 
         Tree(const Tree &) = delete;
 
-        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey) { }
+        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey), freeLeaf(t.freeLeaf) { }
 
         ~Tree();
 
@@ -87,6 +99,10 @@ namespace ART_OLC {
 
         void fast_insert(const Key &k, TID tid, int& fastPointerIndex, ThreadInfo &epocheInfo);
 
+        //insert n distinct keys of keyLength bytes each, stored back to back in ascending order, subtrees under empty
+        //root entries are built bottom-up without locks, must not run concurrently with other writers
+        void bulkBuildSorted(const uint8_t *keys, uint32_t keyLength, const TID *tids, std::size_t n);
+
         bool update(const Key &k, TID tid, ThreadInfo &threadEpocheInfo);
 
         void remove(const Key &k, ThreadInfo &epocheInfo);
@@ -101,7 +117,14 @@ namespace ART_OLC {
 
         long size();
 
-        void makeFastRoot();
+        //number of keys, must not run concurrently with writers
+        std::size_t leafCount();
+
+        //index of the fast pointer to the root, fast lookups from it walk the whole path
+        int makeFastRoot();
+
+        //level the node of a fast pointer matches from, i.e. the key bytes a fast lookup from it skips
+        uint32_t fastPointerLevel(int fastPointerIndex, ThreadInfo &threadEpocheInfo) const;
 
         void getFastPointer(std::vector<uint64_t>& res){
             return fastPointerBuffer.pointerSavedPath(res);
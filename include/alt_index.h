@@ -1,1218 +1,3144 @@
-//
-// Created by yyx on 2023/3/8.
-//
-
-#ifndef ALT_INDEX_ALT_INDEX_H
-#define ALT_INDEX_ALT_INDEX_H
-
-#include "linear_model.h"
-#include "artolc.h"
-#include "utils.h"
-#include "gpl.h"
-#include <stdint.h>
-#include <math.h>
-#include <limits>
-#include <cstdio>
-#include <stack>
-#include <vector>
-#include <cstring>
-#include <map>
-
-#define RT_ASSERT(expr)                                                                     \
-    {                                                                                       \
-        if (!(expr))                                                                        \
-        {                                                                                   \
-            fprintf(stderr, "RT_ASSERT Error at %s:%d, `%s`\n", __FILE__, __LINE__, #expr); \
-            exit(0);                                                                        \
-        }                                                                                   \
-    }
-
-#define PREALLOC_NODE_NUMS 1000000
-#define VECTOR_RESERVE_NUMS 10000000
-#define ARR_GAPS 2
-
-#define USE_FAST_POINTER true
-#define USE_DYNAMIC_RETRAIN true
-
-#define USE_STATISTIC false
-
-// #define ENABLE_DEBUG
-// #define DEBUG
-
-typedef uint8_t bitmap_t;
-#define BITMAP_WIDTH (sizeof(bitmap_t) * 8)
-#define BITMAP_SIZE(numItems) (((numItems) + BITMAP_WIDTH - 1) / BITMAP_WIDTH)
-#define BITMAP_GET(bitmap, pos) (((bitmap)[(pos) / BITMAP_WIDTH] >> ((pos) % BITMAP_WIDTH)) & 1)
-#define BITMAP_SET(bitmap, pos) ((bitmap)[(pos) / BITMAP_WIDTH] |= 1 << ((pos) % BITMAP_WIDTH))
-#define BITMAP_CLEAR(bitmap, pos) ((bitmap)[(pos) / BITMAP_WIDTH] &= ~bitmap_t(1 << ((pos) % BITMAP_WIDTH)))
-
-namespace alt_index
-{
-
-    template <class KeyType, class ValueType>
-    class AltIndex
-    {
-
-        // key-value pairs
-        struct Item
-        {
-            union
-            {
-                struct
-                {
-                    KeyType key;
-                    ValueType value;
-                } data;
-            } components;
-
-            // atomic variable for item concurrency
-            std::atomic<uint64_t> typeVersionLockObsolete;
-
-            // Check if the item is locked based on the version
-            bool isLocked(uint64_t version)
-            {
-                bool locked = ((version & 0b10) == 0b10);
-#ifdef ENABLE_DEBUG
-                std::cout << "Item is " << (locked ? "locked" : "not locked") << " based on version " << version << std::endl;
-#endif
-                return locked;
-            }
-
-            // Check if the item is locked using the current version
-            bool isLocked()
-            {
-                uint64_t currentVersion = this->typeVersionLockObsolete.load();
-                bool locked = ((currentVersion & 0b10) == 0b10);
-#ifdef ENABLE_DEBUG
-                std::cout << "Item is " << (locked ? "locked" : "not locked") << " based on current version " << currentVersion << std::endl;
-#endif
-                return locked;
-            }
-
-            // Acquire a write lock or restart if necessary
-            void writeLockOrRestart(bool &needRestart)
-            {
-                uint64_t version;
-                version = readLockOrRestart(needRestart);
-                if (needRestart)
-                {
-#ifdef ENABLE_DEBUG
-                    std::cout << "Restart needed after read lock attempt." << std::endl;
-#endif
-                    return;
-                }
-
-                upgradeToWriteLockOrRestart(version, needRestart);
-            }
-
-            // Upgrade to a write lock or restart if necessary
-            void upgradeToWriteLockOrRestart(uint64_t &version, bool &needRestart)
-            {
-                uint64_t expected = version;
-                uint64_t desired = version + 0b10;
-                if (this->typeVersionLockObsolete.compare_exchange_strong(expected, desired))
-                {
-                    version = desired;
-#ifdef ENABLE_DEBUG
-                    std::cout << "Successfully upgraded to write lock with version " << version << std::endl;
-#endif
-                }
-                else
-                {
-                    _mm_pause();
-                    needRestart = true;
-#ifdef ENABLE_DEBUG
-                    std::cout << "Failed to upgrade to write lock, restart needed." << std::endl;
-#endif
-                }
-            }
-
-            // Release the write lock
-            void writeUnlock()
-            {
-                this->typeVersionLockObsolete.fetch_add(0b10);
-#ifdef ENABLE_DEBUG
-                std::cout << "Write lock released." << std::endl;
-#endif
-            }
-
-            // Check for restart based on the start read version
-            void checkOrRestart(uint64_t startRead, bool &needRestart) const
-            {
-                readUnlockOrRestart(startRead, needRestart);
-            }
-
-            // Acquire a read lock or restart if necessary
-            uint64_t readLockOrRestart(bool &needRestart)
-            {
-                uint64_t version;
-                version = this->typeVersionLockObsolete.load();
-                if (isLocked(version) || isObsolete(version))
-                {
-                    _mm_pause();
-                    needRestart = true;
-#ifdef ENABLE_DEBUG
-                    std::cout << "Restart needed after read lock attempt due to lock or obsolescence." << std::endl;
-#endif
-                }
-                else
-                {
-#ifdef ENABLE_DEBUG
-                    std::cout << "Read lock acquired with version " << version << std::endl;
-#endif
-                }
-                return version;
-            }
-
-            // Release the read lock or restart if necessary
-            void readUnlockOrRestart(uint64_t startRead, bool &needRestart) const
-            {
-                needRestart = (startRead != this->typeVersionLockObsolete.load());
-                if (needRestart)
-                {
-#ifdef ENABLE_DEBUG
-                    std::cout << "Restart needed after read unlock attempt due to version mismatch." << std::endl;
-#endif
-                }
-                else
-                {
-#ifdef ENABLE_DEBUG
-                    std::cout << "Read lock released successfully." << std::endl;
-#endif
-                }
-            }
-
-            // Mark the item as obsolete
-            void labelObsolete()
-            {
-                this->typeVersionLockObsolete.store((this->typeVersionLockObsolete.load() | 1));
-#ifdef ENABLE_DEBUG
-                std::cout << "Item marked as obsolete." << std::endl;
-#endif
-            }
-
-            // Check if the item is obsolete based on the version
-            bool isObsolete(uint64_t version)
-            {
-                bool obsolete = (version & 1) == 1;
-#ifdef ENABLE_DEBUG
-                std::cout << "Item is " << (obsolete ? "obsolete" : "not obsolete") << " based on version " << version << std::endl;
-#endif
-                return obsolete;
-            }
-
-            // Check if the item is obsolete using the current version
-            bool isObsolete()
-            {
-                uint64_t currentVersion = this->typeVersionLockObsolete.load();
-                bool obsolete = (currentVersion & 1) == 1;
-#ifdef ENABLE_DEBUG
-                std::cout << "Item is " << (obsolete ? "obsolete" : "not obsolete") << " based on current version " << currentVersion << std::endl;
-#endif
-                return obsolete;
-            }
-        };
-
-        // GPL model
-        struct Node
-        {
-            int size;                     // Current size
-            volatile int numInserts;      // Number of inserts
-            volatile int numInsertToData; // Number of inserts to item array
-            int numItems;                 // Number of items
-            LinearModel<KeyType> model;   // Model information
-            Item *items;                  // Pointer to items
-            int fastPointerIndex;         // Fast pointer index
-            bitmap_t *noneBitmap;         // Bitmap pointer
-            Node *expandNode;             // Pointer to expanded node
-            bool expand;                  // Flag for expansion
-            spin_lock expandLock;         // Expand lock
-        };
-
-        Node *root;                  // for initial node
-        std::stack<Node *> nodePool; // pre allocated node and
-
-        // allocate space for nodes
-        std::allocator<Node> nodeAllocator;
-        Node *new_nodes(int n)
-        {
-            Node *p = nodeAllocator.allocate(n);
-            RT_ASSERT(p != NULL && p != (Node *)(-1));
-            return p;
-        }
-        // deallocate space foe nodes
-        void delete_nodes(Node *p, int n)
-        {
-            nodeAllocator.deallocate(p, n);
-        }
-
-        // allocate space for items
-        std::allocator<Item> itemAllocator;
-        Item *new_items(int n)
-        {
-            Item *p = itemAllocator.allocate(n);
-            for (int i = 0; i < n; i++)
-            {
-                p[i].typeVersionLockObsolete = 0b100;
-            }
-            RT_ASSERT(p != NULL && p != (Item *)(-1));
-            return p;
-        }
-
-        // deallocate space for items
-        void delete_items(Item *p, int n)
-        {
-            itemAllocator.deallocate(p, n);
-        }
-
-        // allocate space for bitmap
-        std::allocator<bitmap_t> bitmapAllocator;
-        bitmap_t *new_bitmap(int n)
-        {
-            bitmap_t *p = bitmapAllocator.allocate(n);
-            RT_ASSERT(p != NULL && p != (bitmap_t *)(-1));
-            return p;
-        }
-
-        // deallocate space for bitmap
-        void delete_bitmap(bitmap_t *p, int n)
-        {
-            bitmapAllocator.deallocate(p, n);
-        }
-
-        // calculate the expected position within a GPL model
-        inline int expected_position(Node *node, const KeyType &key) const
-        {
-            int ret = node->model.predict(key);
-            int last_slot = node->numItems - 1;
-
-            if (ret < 0)
-            {
-                return 0;
-            }
-
-            return (ret > last_slot) ? last_slot : ret;
-        }
-
-    public:
-        // bulk load data in pairs
-        typedef std::pair<KeyType, ValueType> payload;
-
-        /**
-         * @brief Constructor to initialize the index structure.
-         */
-        AltIndex()
-        {
-            Node *node = nullptr;
-            for (int i = 0; i < PREALLOC_NODE_NUMS; i++)
-            {
-                node = new_nodes(1);
-                node->numInserts = node->numInsertToData = 0;
-                node->fastPointerIndex = 0;
-                node->expandNode = nullptr;
-                node->expand = false;
-                nodePool.push(node);
-            }
-            root = build_tree_none();
-
-            node_keys.reserve(VECTOR_RESERVE_NUMS);
-            nodes.reserve(VECTOR_RESERVE_NUMS);
-
-            nodes_num = 0;
-            node_keys_num = 0;
-            buffer_num = 0;
-
-            // init the art
-            buffer = new artInterface<KeyType, ValueType>();
-        }
-
-        /**
-         * @brief Destructor to release memory.
-         */
-        ~AltIndex()
-        {
-            for (int i = 0; i < nodes_num; i++)
-            {
-                Node *temp = nodes[i];
-                destroyNode(temp);
-            }
-        }
-
-        /**
-         * @brief Insert a key-value pair into the index.
-         * @param kv Key-value pair
-         * @return True if insertion is successful, false otherwise.
-         */
-        bool insert(const payload &kv)
-        {
-            return insert(kv.first, kv.second);
-        }
-
-        /**
-         * @brief Insert a key-value pair into the index.
-         * @param key Key
-         * @param value Value
-         * @return True if insertion is successful, false otherwise.
-         */
-        bool insert(const KeyType &key, const ValueType &value)
-        {
-            size_t node_pos = binary_search(&node_keys[0], node_keys_num, key);
-            bool ok = false;
-
-            if (node_pos >= nodes_num)
-            {
-                node_pos = nodes_num - 1;
-            }
-
-            Node *node = nodes[node_pos];
-
-            int predict_pos = expected_position(node, key);
-
-        restart:
-            // read lock
-            bool needRestart = false;
-            auto v = node->items[predict_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-
-            // insert to dynamic retrain buffer
-            if (USE_DYNAMIC_RETRAIN && node->expand)
-            {
-                // std::cout << "haha1" << std::endl;
-                if (BITMAP_GET(node->noneBitmap, predict_pos))
-                {
-                    // std::cout << "haha2" << std::endl;
-                    #ifdef DEBUG
-                    if(key == 678844549){
-                        std::cout << "insert to expand node" << key << std::endl;
-                    }
-                    #endif
-                    insertToExpand(node->expandNode, node_pos, key, value);
-                }
-                else
-                {
-                    // std::cout << "haha3" << std::endl;
-                    #ifdef DEBUG
-                    // if(key == 678844549){
-                        std::cout << "insert to data node" << key << std::endl;
-                    // }
-                    #endif
-                    //first evict data at old position, and insert new data to expand node
-                    evictData(node, node_pos, predict_pos);
-                    BITMAP_SET(node->noneBitmap, predict_pos);
-                    // if(node_pos == 143 && predict_pos <= 3){
-                    //     std::cout << "warning key: " << key << "predict pos: " << predict_pos << std::endl;
-                    // }
-                    insertToExpand(node->expandNode, node_pos, key, value);
-                }
-                node->numInserts++;
-                ok = true;
-            }
-            else
-            {   // no expand
-                if (BITMAP_GET(node->noneBitmap, predict_pos))
-                {
-                    // write lock
-                    node->items[predict_pos].upgradeToWriteLockOrRestart(v, needRestart);
-                    if (needRestart)
-                    {
-                        //                        node->items[predict_pos].writeUnlock();
-                        goto restart;
-                    }
-                    BITMAP_CLEAR(node->noneBitmap, predict_pos);
-                    node->items[predict_pos].components.data.key = key;
-                    node->items[predict_pos].components.data.value = value;
-                    node->items[predict_pos].writeUnlock();
-                    #ifdef DEBUG
-                    // if(key == 678844549){
-                        std::cout << "insert to gpl model" << key << std::endl;
-                    // }
-                    #endif
-                }
-                else
-                {
-                    if (USE_DYNAMIC_RETRAIN)
-                    {
-                        if (node->items[predict_pos].components.data.key == 0)
-                        {
-                            node->items[predict_pos].upgradeToWriteLockOrRestart(v, needRestart);
-                            if (needRestart)
-                            {
-                                goto restart;
-                            }
-                            BITMAP_CLEAR(node->noneBitmap, predict_pos);
-                            node->items[predict_pos].components.data.key = key;
-                            node->items[predict_pos].components.data.value = value;
-                            node->items[predict_pos].writeUnlock();
-                            #ifdef DEBUG
-                            // if(key == 678844549){
-                                std::cout << "insert to gpl model sparse slots" << key << std::endl;
-                            // }
-                            #endif
-                        }
-                    }
-                    #ifdef DEBUG
-                    // if(key == 678844549){
-                        std::cout << "node position: " << node_pos << " insert to art" << key << " index :" << predict_pos << std::endl;
-                    // }
-                    #endif
-                    insertToBuffer(node_pos, key, value, node);
-                }
-                node->numInserts++;
-                ok = true;
-            }
-
-            if (USE_DYNAMIC_RETRAIN)
-            {
-                // dynamic retrain
-                if (node->numInserts > node->numItems && node->expand == false)
-                {
-                    node->expandLock.lock();
-                    if (node->expand == false)
-                    {
-                        Node *expandNode = nullptr;
-                        if (nodePool.empty())
-                        {
-                            expandNode = new_nodes(1);
-                        }
-                        else
-                        {
-                            expandNode = nodePool.top();
-                            nodePool.pop();
-                        }
-
-                        expandNode->numInserts = expandNode->numInsertToData = 0;
-                        expandNode->numItems = node->numItems * 2;
-                        expandNode->expandNode = nullptr;
-                        expandNode->expand = false;
-
-                        expandNode->items = new_items(expandNode->numItems);
-                        memset(expandNode->items, 0, sizeof(Item) * expandNode->numItems);
-                        const int bitmap_size = BITMAP_SIZE(expandNode->numItems);
-                        expandNode->noneBitmap = new_bitmap(bitmap_size);
-                        memset(expandNode->noneBitmap, 0xff, sizeof(bitmap_t) * bitmap_size);
-                        expandNode->model.a = node->model.a * 2.0;
-                        expandNode->model.b = 0.0 - node_keys[node_pos] * expandNode->model.a;
-                        expandNode->fastPointerIndex = node->fastPointerIndex;
-
-                        node->expandNode = expandNode;
-                        node->expand = true;
-                        if (node_pos == nodes.size() - 1)
-                        { // last gpl model
-                            Node *newNode = nullptr;
-                            if (nodePool.empty())
-                            {
-                                newNode = new_nodes(1);
-                            }
-                            else
-                            {
-                                newNode = nodePool.top();
-                                nodePool.pop();
-                            }
-                            newNode->numItems = node->numItems;
-                            newNode->numInserts = 0;
-                            newNode->expandNode = nullptr;
-                            newNode->expand = false;
-                            newNode->items = new_items(expandNode->numItems);
-                            const int bitmap_size = BITMAP_SIZE(expandNode->numItems);
-                            newNode->noneBitmap = new_bitmap(bitmap_size);
-                            memset(expandNode->noneBitmap, 0xff, sizeof(bitmap_t) * bitmap_size);
-                            newNode->model.a = node->model.a;
-                            newNode->model.b = node->model.b;
-                            newNode->fastPointerIndex = node->fastPointerIndex;
-                            nodes.emplace_back(newNode);
-
-                            int old_first_key = node_keys[node_keys.size() - 1];
-                            int new_first_key = old_first_key + node->numItems / node->model.a;
-                            node_keys.emplace_back(new_first_key);
-                            node_keys_num++;
-                            buffer->build_fast_pointer(old_first_key, new_first_key, node->fastPointerIndex);
-                        }
-                    }
-                    node->expandLock.unlock();
-                    //    std::cout << "trigger dynamic retraining:" << node_keys[node_pos] << std::endl;
-                }
-                // force evict data
-                if (node->numInserts > 2 * node->numItems && node->expand == true)
-                {
-                    node->numInserts = 0;
-                    for (int i = 0; i < node->numItems; i++)
-                    {
-                        if(!BITMAP_GET(node->noneBitmap, i)){
-                            evictData(node, node_pos, i);
-                            BITMAP_SET(node->noneBitmap, i);
-                        }
-                    }
-                    // update pointer
-                    nodes[node_pos] = nodes[node_pos]->expandNode;
-                    // std::cout << "finish expansion" << node_pos << std::endl;
-                }
-            }
-            return ok;
-        }
-
-        /**
-         * @brief Find the value associated with a key in the index.
-         * @param key Key
-         * @param exist Flag to store whether the key exists
-         * @return If the key exists, return its corresponding value; otherwise, return the default value.
-         */
-        ValueType find(const KeyType &key, bool &exist)
-        {
-
-            size_t node_pos = binary_search(&node_keys[0], node_keys_num, key);
-            if (node_pos >= nodes_num)
-            {
-                node_pos = nodes_num - 1;
-            }
-
-            Node *node = nodes[node_pos];
-            int key_pos = expected_position(node, key);
-        // read lock
-        restart:
-            bool needRestart = false;
-            auto v = node->items[key_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-            if (BITMAP_GET(node->noneBitmap, key_pos))
-            {
-                if (USE_DYNAMIC_RETRAIN && node->expand)
-                {
-                    return searchInExpand(node->expandNode, exist, node_pos, key);
-                }
-                else
-                {
-                    // if(key == 349517445){
-                    //     std::cout << "node position: " << node_pos << " not found " << key << "position:" << key_pos << std::endl;
-                    // }
-                    exist = false;
-                    return static_cast<ValueType>(0);
-                }
-            }
-            else
-            {
-                // key exist in node
-                if (node->items[key_pos].components.data.key == key)
-                {
-                    node->items[key_pos].readUnlockOrRestart(v, needRestart);
-                    if (needRestart)
-                        goto restart;
-
-                    exist = true;
-                    return node->items[key_pos].components.data.value;
-                }
-                else
-                {
-                    if (USE_DYNAMIC_RETRAIN)
-                    {
-                        if (node->expand){
-                            return searchInExpand(node->expandNode, exist, node_pos, key);
-                        }
-
-                        ValueType ret = searchInBuffer(node_pos, key, exist, node);
-                        if (exist && node->items[key_pos].components.data.key == 0)
-                        {
-                            node->items[key_pos].components.data.value = ret;
-                            node->items[key_pos].components.data.key = key;
-                        }
-                        return ret;
-                    }
-
-                    return searchInBuffer(node_pos, key, exist, node);
-                }
-            }
-            return static_cast<ValueType>(0);
-        }
-
-        /**
-         * @brief Update the value associated with a key in the index.
-         * @param key Key
-         * @param value New value
-         * @return True if the update is successful, false otherwise.
-         */
-        bool update(const KeyType &key, const ValueType &value)
-        {
-            size_t node_pos = binary_search(&node_keys[0], node_keys_num, key);
-            if (node_pos >= nodes_num)
-            {
-                node_pos = nodes_num - 1;
-            }
-
-            Node *node = nodes[node_pos];
-            int key_pos = expected_position(node, key);
-        // read lock
-        restart:
-            bool needRestart = false;
-            auto v = node->items[key_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-            if (BITMAP_GET(node->noneBitmap, key_pos))
-            {
-                if (USE_DYNAMIC_RETRAIN && node->expand)
-                {
-                    return updateInExpand(node->expandNode, node_pos, key, value);
-                }
-                else
-                {
-                    return false;
-                }
-            }
-            else
-            {
-                // key exist in node
-                if (node->items[key_pos].components.data.key == key)
-                {
-                    node->items[key_pos].readUnlockOrRestart(v, needRestart);
-                    if (needRestart)
-                        goto restart;
-
-                    return true;
-                }
-                else
-                {
-                    if (USE_DYNAMIC_RETRAIN && node->expand)
-                    {
-                        return updateInExpand(node->expandNode, node_pos, key, value);
-                    }
-
-                    return buffer->update(key, value);
-                }
-            }
-            return true;
-        }
-
-        /**
-         * @brief Remove a key-value pair from the index.
-         * @param key Key
-         * @return True if removal is successful, false otherwise.
-         */
-        bool remove(const KeyType &key)
-        {
-            size_t node_pos = binary_search(&node_keys[0], node_keys_num, key);
-            bool ok = true;
-
-            if (node_pos >= nodes_num)
-            {
-                node_pos = nodes_num - 1;
-            }
-
-            Node *node = nodes[node_pos];
-            int predict_pos = expected_position(node, key);
-
-        restart:
-            bool needRestart = false;
-            // read lock
-            auto v = node->items[predict_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-
-            // data doesn't exist
-            if (BITMAP_GET(node->noneBitmap, predict_pos))
-            {
-                return ok;
-            }
-            else
-            {
-                // write lock
-                node->items[predict_pos].upgradeToWriteLockOrRestart(v, needRestart);
-                if (needRestart)
-                {
-                    //                    node->items[predict_pos].writeUnlock();
-                    goto restart;
-                }
-
-                if (node->items[predict_pos].components.data.key == key)
-                {
-                    node->items[predict_pos].components.data.key = 0;
-                    node->items[predict_pos].writeUnlock();
-                }
-                else
-                {
-                    node->items[predict_pos].writeUnlock();
-                    if (USE_FAST_POINTER)
-                        ok = buffer->fast_remove(key, node->fastPointerIndex);
-                    else
-                        ok = buffer->remove(key);
-                    if (USE_STATISTIC)
-                    {
-                        if (ok)
-                            buffer_num--;
-                    }
-                }
-            }
-            return ok;
-        }
-
-        /**
-         * @brief Perform a range query within the given range and return the number of key-value pairs.
-         * @param start Start key of the range
-         * @param end End key of the range
-         * @return The number of key-value pairs within the specified range.
-         */
-        int rangeQuery(std::pair<KeyType, ValueType> *results, const KeyType &start, int len)
-        {
-            int result_count = 0;
-
-            int node_pos = binary_search(&node_keys[0], node_keys_num, start);
-
-            if (node_pos == -1)
-                node_pos = 0;
-
-            Node *cur_node = nodes[node_pos];
-            int cur_pos = expected_position(cur_node, start);
-
-            while (result_count < len)
-            {
-                if (cur_pos > cur_node->numItems)
-                {
-                    node_pos++;
-                    if (node_pos >= nodes_num)
-                        break;
-                    cur_node = nodes[node_pos];
-                    cur_pos = 0;
-                }
-                if (!BITMAP_GET(cur_node->noneBitmap, cur_pos))
-                {
-                    results[result_count] = {cur_node->items[cur_pos].components.data.key, cur_node->items[cur_pos].components.data.value};
-                    result_count++;
-                }
-                cur_pos++;
-            }
-
-            result_count += buffer->scan(start, results[result_count - 1].first, len);
-            return result_count >= len ? len : result_count;
-        }
-
-        // evict the data of the evict_pos of node
-        void evictData(Node *node, const int &node_pos, const int &evict_pos)
-        {
-            // check expand node bitmap and evict the data
-            if(node->items[evict_pos].components.data.key != 0){
-                #ifdef DEBUG
-                // if(node->items[evict_pos].components.data.key == 678844549){
-                    std::cout << "evict to expand node" << node->items[evict_pos].components.data.key << std::endl;
-                // }
-                #endif
-                insertToExpand(node->expandNode, node_pos, node->items[evict_pos].components.data.key, node->items[evict_pos].components.data.value);
-            }
-            BITMAP_CLEAR(node->expandNode->noneBitmap, evict_pos * 2);
-            BITMAP_CLEAR(node->expandNode->noneBitmap, evict_pos * 2 + 1);
-        }
-
-        void insertToExpand(Node *expandNode, const int &node_pos, const KeyType &key, const ValueType &value)
-        {
-            int expand_pos = expected_position(expandNode, key);
-            bool needRestart = false;
-
-        restart:
-            // read lock
-            auto v = expandNode->items[expand_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-            if (BITMAP_GET(expandNode->noneBitmap, expand_pos))
-            {
-                expandNode->items[expand_pos].upgradeToWriteLockOrRestart(v, needRestart);
-                if (needRestart)
-                {
-                    //                    expandNode->items[expand_pos].writeUnlock();
-                    goto restart;
-                }
-
-                BITMAP_CLEAR(expandNode->noneBitmap, expand_pos);
-                expandNode->items[expand_pos].components.data.key = key;
-                expandNode->items[expand_pos].components.data.value = value;
-                expandNode->items[expand_pos].writeUnlock();
-                #ifdef DEBUG
-                // if(key == 678844549){
-                    std::cout << "evict and insert to expand node" << key << std::endl;
-                // }
-                #endif
-            }
-            else
-            {
-                // std::cout << "haha5" << std::endl;
-                if(expandNode->items[expand_pos].components.data.key == 0){
-                    expandNode->items[expand_pos].upgradeToWriteLockOrRestart(v, needRestart);
-                    if (needRestart)
-                    {
-                        //                    expandNode->items[expand_pos].writeUnlock();
-                        goto restart;
-                    }
-
-                    expandNode->items[expand_pos].components.data.key = key;
-                    expandNode->items[expand_pos].components.data.value = value;
-                    expandNode->items[expand_pos].writeUnlock();
-                }
-                else{
-                    #ifdef DEBUG
-                    // if(key == 678844549){
-                        std::cout << "evict and insert to buffer" << key << std::endl;
-                    // }
-                    #endif
-                    insertToBuffer(node_pos, key, value, expandNode);
-                }
-            }
-            expandNode->numInserts++;
-        }
-
-        void insertToBuffer(const int &node_pos, const KeyType &key, const ValueType &value, Node *node)
-        {
-            // insert to buffer
-            if (USE_FAST_POINTER)
-            {
-                if (node_pos < nodes_num - 1)
-                {
-                    // std::cout << "haha6" << std::endl;
-                    // std::cout << node_pos << " " << key << std::endl;
-                    ValueType haha;
-                    // std::cout << buffer->fastGet(key, haha, node->fastPointerIndex) << std::endl;
-                    buffer->fastPut(key, value, node->fastPointerIndex);
-                    if (USE_STATISTIC)
-                    {
-                        buffer_num++;
-                    }
-                }
-                else
-                {
-                    // std::cout << "haha7" << std::endl;
-                    buffer->put(key, value);
-                    if (USE_STATISTIC)
-                    {
-                        buffer_num++;
-                    }
-                }
-            }
-            else
-            {
-                buffer->put(key, value);
-                if (USE_STATISTIC)
-                {
-                    buffer_num++;
-                }
-            }
-        }
-
-        ValueType searchInExpand(Node *expandNode, bool &exist, const int &node_pos, const KeyType &key)
-        {
-        restart:
-            bool needRestart = false;
-            int expand_pos = expected_position(expandNode, key);
-            auto v = expandNode->items[expand_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-
-            if (BITMAP_GET(expandNode->noneBitmap, expand_pos))
-            {
-                return searchInBuffer(node_pos, key, exist, expandNode);
-            }
-            else
-            {
-                // slot is occupied
-                if (expandNode->items[expand_pos].components.data.key == key)
-                {
-                    expandNode->items[expand_pos].readUnlockOrRestart(v, needRestart);
-                    if (needRestart)
-                        goto restart;
-
-                    exist = true;
-                    return expandNode->items[expand_pos].components.data.value;
-                }
-                else
-                {
-                    ValueType ret_val;
-                    // if the fast pointer is invalid
-                    ret_val = searchInBuffer(node_pos, key, exist, expandNode);
-                    return ret_val;
-                }
-            }
-        }
-
-        ValueType searchInBuffer(const int &node_pos, const KeyType &key, bool &exist, Node *node)
-        {
-            ValueType ret_val;
-            if (USE_FAST_POINTER)
-            {
-                if (node_pos < nodes_num - 1)
-                {
-                    if (buffer->fastGet(key, ret_val, node->fastPointerIndex))
-                    {
-                        exist = true;
-                        return ret_val;
-                    }
-                    else
-                    {
-                        exist = false;
-                        return static_cast<ValueType>(0);
-                    }
-                }
-                else
-                {
-                    if (buffer->get(key, ret_val))
-                    {
-                        exist = true;
-                        return ret_val;
-                    }
-                    else
-                    {
-                        exist = false;
-                        return static_cast<ValueType>(0);
-                    }
-                }
-            }
-            // if the fast pointer is valid
-            else
-            {
-
-                if (buffer->get(key, ret_val))
-                {
-                    exist = true;
-                    return ret_val;
-                }
-                else
-                {
-                    exist = false;
-                    return static_cast<ValueType>(0);
-                }
-            }
-        }
-
-        bool updateInExpand(Node *expandNode, const int &node_pos, const KeyType &key, const ValueType &value)
-        {
-        restart:
-            bool needRestart = false;
-            int expand_pos = expected_position(expandNode, key);
-            auto v = expandNode->items[expand_pos].readLockOrRestart(needRestart);
-            if (needRestart)
-                goto restart;
-
-            if (BITMAP_GET(expandNode->noneBitmap, expand_pos))
-            {
-                return buffer->update(key, value);
-            }
-            else
-            {
-                // slot is occupied
-                if (expandNode->items[expand_pos].components.data.key == key)
-                {
-                    expandNode->items[expand_pos].upgradeToWriteLockOrRestart(v, needRestart);
-                    if (needRestart)
-                        goto restart;
-                    expandNode->items[expand_pos].components.data.value = value;
-                    return true;
-                }
-                else
-                {
-                    return buffer->update(key, value);
-                }
-            }
-        }
-
-        /**
-         * @brief Destroy a node and reclaim memory.
-         * @param node The node to be destroyed.
-         */
-        void destroyNode(Node *node)
-        {
-            if (node == nullptr)
-                return;
-
-            delete_items(node->items, node->numItems);
-            const int bitmap_size = BITMAP_SIZE(node->numItems);
-            delete_bitmap(node->noneBitmap, bitmap_size);
-        }
-
-        /**
-         * @brief Build an empty node.
-         * @return The newly created node.
-         */
-        Node *build_tree_none()
-        {
-            Node *node = new_nodes(1);
-            node->numInserts = node->numInsertToData = 0;
-            node->numItems = 1;
-            node->model.a = node->model.b = 0;
-            return node;
-        }
-
-        /**
-         * @brief Bulk load data to build the index.
-         * @param kv Array of key-value pairs
-         * @param num_keys Number of data points
-         */
-        void bulkLoad(const payload *kv, const int &num_keys)
-        {
-            if (num_keys == 0 || num_keys == 1)
-            {
-                return;
-            }
-
-            // check array is mono
-            for (int i = 1; i < num_keys; i++)
-            {
-                RT_ASSERT(kv[i].first > kv[i - 1].first);
-            }
-
-            KeyType *keys = new KeyType[num_keys];
-            ValueType *values = new ValueType[num_keys];
-            for (int i = 0; i < num_keys; i++)
-            {
-                keys[i] = kv[i].first;
-                values[i] = kv[i].second;
-            }
-
-            int used_index = 0;
-            int remain_nums = num_keys;
-            // make segment partition
-            while (remain_nums > 0)
-            {
-                Segment segment;
-                segmentPartition(keys + used_index, remain_nums, segment, num_keys / 1000);
-                nodes.push_back(bulkLoadNode(keys + used_index, values, segment));
-                nodes_num++;
-                used_index += segment.numItems;
-                remain_nums -= segment.numItems;
-                node_keys.push_back(segment.firstKey);
-                node_keys_num++;
-            }
-            if (USE_FAST_POINTER)
-                buildFastPointer();
-
-            delete[] keys;
-            delete[] values;
-        }
-
-        // bulk loading a node, each node corresponds to a segment
-        Node *bulkLoadNode(KeyType *keys, ValueType *values, const Segment &segment)
-        {
-            Node *node;
-            // first find in node pool
-            if (nodePool.empty())
-            {
-                node = new_nodes(1);
-            }
-            else
-            {
-                node = nodePool.top();
-                nodePool.pop();
-            }
-
-            const int size = segment.numItems;
-
-            node->numInserts = node->numInsertToData = 0;
-
-            // init a and b
-            node->model.a = ((segment.upperSlope + segment.lowerSlope) / 2) * (1.0 + ARR_GAPS);
-            //            node->model.a = segment.upperSlope * (1.0 + ARR_GAPS);
-            node->model.b = 0.0 - node->model.a * segment.firstKey;
-            RT_ASSERT(isfinite(node->model.a));
-            RT_ASSERT(isfinite(node->model.b));
-
-            node->numItems = size * (1.0 + ARR_GAPS);
-            node->items = new_items(node->numItems);
-            const int bitmap_size = BITMAP_SIZE(node->numItems);
-            node->noneBitmap = new_bitmap(bitmap_size);
-            memset(node->noneBitmap, 0xff, sizeof(bitmap_t) * bitmap_size);
-            memset(node->items, 0, sizeof(Item) * node->numItems);
-
-            node->fastPointerIndex = 0;
-
-            for (int index = 0; index < size; index++)
-            {
-                int predict_pos = expected_position(node, keys[index]);
-                // slot is empty
-                if (BITMAP_GET(node->noneBitmap, predict_pos))
-                {
-                    BITMAP_CLEAR(node->noneBitmap, predict_pos);
-                    node->items[predict_pos].components.data.key = keys[index];
-                    node->items[predict_pos].components.data.value = values[index];
-                    node->numInsertToData++;
-                    #ifdef DEBUG
-                    if(keys[index] == 678844549){
-                        std::cout << "bulkload to node" << keys[index] << std::endl;
-                    }
-                    #endif
-                }
-                else
-                {
-                    //                     buffer[keys[index]] = values[index];
-                    buffer->put(keys[index], values[index]);
-                    if (USE_STATISTIC)
-                    {
-                        buffer_num++;
-                    }
-                    #ifdef DEBUG
-                    if(keys[index] == 678844549){
-                        std::cout << "bulkload to buffer" << keys[index] << std::endl;
-                    }
-                    #endif
-                }
-                node->numInserts++;
-            }
-            return node;
-        }
-
-        void buildFastPointer()
-        {
-            int ret;
-            for (int i = 0; i < nodes_num - 1; i++)
-            {
-                buffer->build_fast_pointer(node_keys[i], node_keys[i + 1], ret);
-                nodes[i]->fastPointerIndex = ret;
-                //                flag < ret.second ? (flag = ret.second) : 0 ;
-            }
-            nodes[nodes_num - 1]->fastPointerIndex = 0;
-        }
-
-        /**
-         * @brief Calculate the memory consumption of the index structure.
-         * @return Memory consumption size.
-         */
-        long long memoryConsumption() const
-        {
-            long long size = 0;
-
-            for (int i = 0; i < nodes.size(); i++)
-            {
-                //                size += sizeof(Node);
-                //                size += sizeof(*(nodes[i]->noneBitmap));
-                size += sizeof(nodes[i]->noneBitmap);
-                //                size += sizeof(KeyType);
-                //                for(int i = 0 ; i < nodes[i]->numItems ; i++){
-                //                    size += sizeof(Item);
-                //                }
-                size += sizeof(Item) * nodes[i]->numItems;
-            }
-            size += buffer->memory_consumption();
-            return size;
-        }
-
-        /**
-         * @brief Print information about fast pointers.
-         */
-        void printFastPointer()
-        {
-            std::vector<uint64_t> res;
-            buffer->get_fast_pointer(res);
-            long double save_path_num = 0.0;
-            for (auto node : nodes)
-            {
-                save_path_num += res[node->fastPointerIndex] * (node->numInserts - node->numInsertToData);
-            }
-            std::cout << "average reduced path length:" << save_path_num / buffer_num << std::endl;
-            std::cout << "fast buffer size:" << res.size() << std::endl;
-        }
-
-    public:
-        std::vector<Node *> nodes;      // store model nodes
-        std::vector<KeyType> node_keys; // through node_keys to locate model index
-        //        std::map<KeyType, ValueType> buffer;  //conflict data will be put into buffer
-        artInterface<KeyType, ValueType> *buffer;
-
-        long long nodes_num;
-        long long node_keys_num;
-        long long buffer_num;
-    };
-
-}
-
-#endif // ALT_INDEX_ALT_INDEX_H
+//
+// Created by yyx on 2023/3/8.
+//
+
+#ifndef ALT_INDEX_ALT_INDEX_H
+#define ALT_INDEX_ALT_INDEX_H
+
+#include "linear_model.h"
+#include "artolc.h"
+#include "utils.h"
+#include "gpl.h"
+#include "directory.h"
+#include "retrain.h"
+#include "epoch.h"
+#include "snapshot.h"
+#include "wal.h"
+#include <stdint.h>
+#include <math.h>
+#include <limits>
+#include <cstdio>
+#include <stack>
+#include <vector>
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <type_traits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define RT_ASSERT(expr)                                                                     \
+    {                                                                                       \
+        if (!(expr))                                                                        \
+        {                                                                                   \
+            fprintf(stderr, "RT_ASSERT Error at %s:%d, `%s`\n", __FILE__, __LINE__, #expr); \
+            exit(0);                                                                        \
+        }                                                                                   \
+    }
+
+#define PREALLOC_NODE_NUMS 1000000
+#define ARR_GAPS 2
+#define FIND_BATCH_GROUP 16
+
+#define USE_FAST_POINTER true
+#define USE_DYNAMIC_RETRAIN true
+// sample buffer lookups and move the fast pointers of nodes to the heat of their buffer accesses
+#ifndef USE_ADAPTIVE_FAST_POINTER
+#define USE_ADAPTIVE_FAST_POINTER false
+#endif
+#define FAST_POINTER_SAMPLE 64          // one in this many buffer lookups of a thread is sampled
+#define FAST_POINTER_HOT_READS 16       // sampled lookups of a node since the last adaptation to be hot
+#define FAST_POINTER_MAX_RANGES 16      // most sub-range fast pointers of a hot node
+#define FAST_POINTER_ADAPT_PERIOD 65536 // sampled lookups between two adaptations
+
+#define USE_STATISTIC false
+
+// store slot keys, values and locks in separate arrays so that probes only touch the keys
+#ifndef USE_SOA_LAYOUT
+#define USE_SOA_LAYOUT false
+#endif
+// place conflicting keys in empty slots right after the predicted one and scan them before the buffer
+#ifndef USE_LOCAL_SEARCH
+#define USE_LOCAL_SEARCH false
+#endif
+#define LOCAL_SEARCH_WINDOW 8 // slots after the predicted one searched for a key
+// build expand nodes and evict expanded nodes on background threads instead of in insert()
+#ifndef USE_ASYNC_RETRAIN
+#define USE_ASYNC_RETRAIN false
+#endif
+#define RETRAIN_THREAD_NUM 1
+// threads of bulkLoad(), 0 for one per hardware thread
+#ifndef BULK_LOAD_THREAD_NUM
+#define BULK_LOAD_THREAD_NUM 0
+#endif
+#define BULK_LOAD_MIN_PART 65536 // least keys per bulk load thread
+// refit GPL segments over the live keys of an expanded node instead of publishing its 2x expand node
+#ifndef USE_SEGMENT_RETRAIN
+#define USE_SEGMENT_RETRAIN true
+#endif
+// nodes rebuilt by compact(): more gaps, a tighter error bound, and only nodes with many buffered keys
+#define COMPACTION_GAPS (ARR_GAPS + 1)
+#define COMPACTION_ERROR_DIV 16 // error bound of the bulk load divided by this
+#define COMPACTION_MIN_BUFFERED 0.25 // least share of buffered keys among the live keys of a node
+
+#ifndef SOA_LOCK_STRIPE
+#define SOA_LOCK_STRIPE 8 // slots sharing one lock in the SoA layout
+#endif
+#define SOA_LOCK_NUM(numItems) (((numItems) + SOA_LOCK_STRIPE - 1) / SOA_LOCK_STRIPE)
+
+// #define ENABLE_DEBUG
+// #define DEBUG
+
+// a set bit marks an empty slot, the bits past the last slot are set as well
+typedef uint64_t bitmap_t;
+#define BITMAP_WIDTH (sizeof(bitmap_t) * 8)
+#define BITMAP_SIZE(numItems) (((numItems) + BITMAP_WIDTH - 1) / BITMAP_WIDTH)
+#define BITMAP_GET(bitmap, pos) (((bitmap)[(pos) / BITMAP_WIDTH] >> ((pos) % BITMAP_WIDTH)) & 1)
+// slots sharing a bitmap word are guarded by different slot locks, so the word is updated atomically
+#define BITMAP_SET(bitmap, pos) \
+    __atomic_fetch_or(&(bitmap)[(pos) / BITMAP_WIDTH], bitmap_t(1) << ((pos) % BITMAP_WIDTH), __ATOMIC_RELAXED)
+#define BITMAP_CLEAR(bitmap, pos) \
+    __atomic_fetch_and(&(bitmap)[(pos) / BITMAP_WIDTH], ~(bitmap_t(1) << ((pos) % BITMAP_WIDTH)), __ATOMIC_RELAXED)
+
+namespace alt_index
+{
+    static_assert(sizeof(bitmap_t) == sizeof(unsigned long long), "the bitmap is scanned with 64-bit bit counts");
+
+    // the occupied slots of [begin, end) in slot order, taken a bitmap word at a time
+    class OccupiedSlots
+    {
+    public:
+        OccupiedSlots(const bitmap_t *bitmap, const int begin, const int end)
+            : bitmap(bitmap), end(end), words(BITMAP_SIZE(end)), word(begin / BITMAP_WIDTH), bits(0)
+        {
+            if (begin < end)
+                bits = ~bitmap[word] & (~bitmap_t(0) << (begin % BITMAP_WIDTH));
+        }
+
+        // next occupied slot, end once there is none
+        int next()
+        {
+            while (bits == 0)
+            {
+                if (++word >= words)
+                    return end;
+#ifdef __AVX2__
+                // skip 256 empty slots per test
+                const __m256i empty = _mm256_set1_epi64x(-1);
+                while (word + 4 <= words &&
+                       _mm256_testc_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap + word)), empty))
+                    word += 4;
+                if (word >= words)
+                    return end;
+#endif
+                bits = ~bitmap[word];
+            }
+            const int pos = word * BITMAP_WIDTH + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            return pos < end ? pos : end;
+        }
+
+    private:
+        const bitmap_t *bitmap;
+        int end;
+        int words;
+        int word;
+        bitmap_t bits; // occupied slots of the word not returned yet
+    };
+
+    // number of occupied slots in [begin, end)
+    inline int bitmap_count_occupied(const bitmap_t *bitmap, const int begin, const int end)
+    {
+        if (begin >= end)
+            return 0;
+        const int first = begin / BITMAP_WIDTH, last = (end - 1) / BITMAP_WIDTH;
+        int count = 0;
+        for (int word = first; word <= last; word++)
+        {
+            bitmap_t occupied = ~bitmap[word];
+            if (word == first)
+                occupied &= ~bitmap_t(0) << (begin % BITMAP_WIDTH);
+            if (word == last && end % BITMAP_WIDTH != 0)
+                occupied &= ~(~bitmap_t(0) << (end % BITMAP_WIDTH));
+            count += __builtin_popcountll(occupied);
+        }
+        return count;
+    }
+
+    // result of AltIndex::compact(), buffer counts cover the key ranges of the rebuilt nodes
+    struct CompactionStats
+    {
+        long long nodes;        // nodes rebuilt
+        long long newNodes;     // nodes that replaced them
+        long long bufferBefore; // buffered keys before the rebuild
+        long long bufferAfter;  // keys left in the buffer after the rebuild
+    };
+
+    template <class KeyType, class ValueType>
+    class FrozenAltIndex;
+
+    template <class KeyType, class ValueType>
+    class AltIndex
+    {
+        // builds its file from the nodes and the buffer
+        friend class FrozenAltIndex<KeyType, ValueType>;
+
+        // optimistic version lock of a slot
+        struct SlotLock
+        {
+            // atomic variable for item concurrency
+            std::atomic<uint64_t> typeVersionLockObsolete;
+
+            // Check if the item is locked based on the version
+            bool isLocked(uint64_t version)
+            {
+                bool locked = ((version & 0b10) == 0b10);
+#ifdef ENABLE_DEBUG
+                std::cout << "Item is " << (locked ? "locked" : "not locked") << " based on version " << version << std::endl;
+#endif
+                return locked;
+            }
+
+            // Check if the item is locked using the current version
+            bool isLocked()
+            {
+                uint64_t currentVersion = this->typeVersionLockObsolete.load();
+                bool locked = ((currentVersion & 0b10) == 0b10);
+#ifdef ENABLE_DEBUG
+                std::cout << "Item is " << (locked ? "locked" : "not locked") << " based on current version " << currentVersion << std::endl;
+#endif
+                return locked;
+            }
+
+            // Acquire a write lock or restart if necessary
+            void writeLockOrRestart(bool &needRestart)
+            {
+                uint64_t version;
+                version = readLockOrRestart(needRestart);
+                if (needRestart)
+                {
+#ifdef ENABLE_DEBUG
+                    std::cout << "Restart needed after read lock attempt." << std::endl;
+#endif
+                    return;
+                }
+
+                upgradeToWriteLockOrRestart(version, needRestart);
+            }
+
+            // Upgrade to a write lock or restart if necessary
+            void upgradeToWriteLockOrRestart(uint64_t &version, bool &needRestart)
+            {
+                uint64_t expected = version;
+                uint64_t desired = version + 0b10;
+                if (this->typeVersionLockObsolete.compare_exchange_strong(expected, desired))
+                {
+                    version = desired;
+#ifdef ENABLE_DEBUG
+                    std::cout << "Successfully upgraded to write lock with version " << version << std::endl;
+#endif
+                }
+                else
+                {
+                    _mm_pause();
+                    needRestart = true;
+#ifdef ENABLE_DEBUG
+                    std::cout << "Failed to upgrade to write lock, restart needed." << std::endl;
+#endif
+                }
+            }
+
+            // Release the write lock
+            void writeUnlock()
+            {
+                this->typeVersionLockObsolete.fetch_add(0b10);
+#ifdef ENABLE_DEBUG
+                std::cout << "Write lock released." << std::endl;
+#endif
+            }
+
+            // Check for restart based on the start read version
+            void checkOrRestart(uint64_t startRead, bool &needRestart) const
+            {
+                readUnlockOrRestart(startRead, needRestart);
+            }
+
+            // Acquire a read lock or restart if necessary
+            uint64_t readLockOrRestart(bool &needRestart)
+            {
+                uint64_t version;
+                version = this->typeVersionLockObsolete.load();
+                if (isLocked(version) || isObsolete(version))
+                {
+                    _mm_pause();
+                    needRestart = true;
+#ifdef ENABLE_DEBUG
+                    std::cout << "Restart needed after read lock attempt due to lock or obsolescence." << std::endl;
+#endif
+                }
+                else
+                {
+#ifdef ENABLE_DEBUG
+                    std::cout << "Read lock acquired with version " << version << std::endl;
+#endif
+                }
+                return version;
+            }
+
+            // Release the read lock or restart if necessary
+            void readUnlockOrRestart(uint64_t startRead, bool &needRestart) const
+            {
+                needRestart = (startRead != this->typeVersionLockObsolete.load());
+                if (needRestart)
+                {
+#ifdef ENABLE_DEBUG
+                    std::cout << "Restart needed after read unlock attempt due to version mismatch." << std::endl;
+#endif
+                }
+                else
+                {
+#ifdef ENABLE_DEBUG
+                    std::cout << "Read lock released successfully." << std::endl;
+#endif
+                }
+            }
+
+            // Mark the item as obsolete
+            void labelObsolete()
+            {
+                this->typeVersionLockObsolete.store((this->typeVersionLockObsolete.load() | 1));
+#ifdef ENABLE_DEBUG
+                std::cout << "Item marked as obsolete." << std::endl;
+#endif
+            }
+
+            // Check if the item is obsolete based on the version
+            bool isObsolete(uint64_t version)
+            {
+                bool obsolete = (version & 1) == 1;
+#ifdef ENABLE_DEBUG
+                std::cout << "Item is " << (obsolete ? "obsolete" : "not obsolete") << " based on version " << version << std::endl;
+#endif
+                return obsolete;
+            }
+
+            // Check if the item is obsolete using the current version
+            bool isObsolete()
+            {
+                uint64_t currentVersion = this->typeVersionLockObsolete.load();
+                bool obsolete = (currentVersion & 1) == 1;
+#ifdef ENABLE_DEBUG
+                std::cout << "Item is " << (obsolete ? "obsolete" : "not obsolete") << " based on current version " << currentVersion << std::endl;
+#endif
+                return obsolete;
+            }
+        };
+
+        // key-value pairs
+        struct Item : SlotLock
+        {
+            union
+            {
+                struct
+                {
+                    KeyType key;
+                    ValueType value;
+                } data;
+            } components;
+        };
+
+        // fast pointers of the sub-ranges of a hot node, one per value of the first key byte its range spans
+        struct FastRanges
+        {
+            int shift;     // bit offset of that byte in the key
+            int firstByte; // its value in the first key of the node
+            int num;       // number of sub-ranges
+            int pointerIndex[FAST_POINTER_MAX_RANGES];
+
+            bool operator==(const FastRanges &other) const
+            {
+                return shift == other.shift && firstByte == other.firstByte && num == other.num &&
+                       std::equal(pointerIndex, pointerIndex + num, other.pointerIndex);
+            }
+        };
+
+        // GPL model
+        struct Node
+        {
+            int size;                     // Current size
+            volatile int numInserts;      // Number of inserts
+            volatile int numInsertToData; // Number of inserts to item array
+            int numItems;                 // Number of items
+            LinearModel<KeyType> model;   // Model information
+#if USE_SOA_LAYOUT
+            KeyType *keys;                // Slot keys
+            ValueType *values;            // Slot values
+            SlotLock *locks;              // Slot locks, one per SOA_LOCK_STRIPE slots
+#else
+            Item *items;                  // Pointer to items
+#endif
+            int fastPointerIndex;         // Fast pointer index
+            std::atomic<FastRanges *> fastRanges; // Sub-range fast pointers of a hot node, nullptr if none
+            volatile int bufferReads;     // Sampled buffer lookups since the last adaptation
+            bitmap_t *noneBitmap;         // Bitmap pointer
+            Node *expandNode;             // Pointer to expanded node
+            bool expand;                  // Flag for expansion
+            spin_lock expandLock;         // Expand lock
+
+#if USE_SOA_LAYOUT
+            inline KeyType &slotKey(int pos) { return keys[pos]; }
+            inline ValueType &slotValue(int pos) { return values[pos]; }
+            inline SlotLock &slotLock(int pos) { return locks[pos / SOA_LOCK_STRIPE]; }
+#else
+            inline KeyType &slotKey(int pos) { return items[pos].components.data.key; }
+            inline ValueType &slotValue(int pos) { return items[pos].components.data.value; }
+            inline SlotLock &slotLock(int pos) { return items[pos]; }
+#endif
+        };
+
+        typedef typename NodeDirectory<KeyType, Node>::Version DirectoryVersion;
+
+        Node *root;                  // for initial node
+        std::stack<Node *> nodePool; // pre allocated node and
+        spin_lock nodePoolLock;      // nodes are taken from the pool by concurrent expansions
+
+        // take a node from the node pool, or allocate one if it runs out
+        Node *allocNode()
+        {
+            Node *node = nullptr;
+            nodePoolLock.lock();
+            if (!nodePool.empty())
+            {
+                node = nodePool.top();
+                nodePool.pop();
+            }
+            nodePoolLock.unlock();
+            return node == nullptr ? new_nodes(1) : node;
+        }
+
+        /**
+         * @brief Append an empty node after the last node, covering the keys past the range of its model.
+         * @param last The last node, its expand lock is held by the caller
+         * @param first_key First key of the last node
+         */
+        void appendNode(Node *last, const KeyType &first_key)
+        {
+            if (!(last->model.a > 0))
+                return;
+            const double bound = static_cast<double>(first_key) + last->numItems / last->model.a;
+            if (bound >= static_cast<double>(std::numeric_limits<KeyType>::max()))
+                return;
+
+            // keys past the model range are clamped into the last slot, lock it so the new first key stays above them
+            SlotLock &last_lock = last->slotLock(last->numItems - 1);
+            bool needRestart;
+            do
+            {
+                needRestart = false;
+                last_lock.writeLockOrRestart(needRestart);
+            } while (needRestart);
+
+            KeyType new_first_key = static_cast<KeyType>(bound);
+            if (new_first_key <= first_key)
+                new_first_key = first_key + 1;
+            if (!BITMAP_GET(last->noneBitmap, last->numItems - 1))
+            {
+                if (last->slotKey(last->numItems - 1) >= new_first_key)
+                    new_first_key = last->slotKey(last->numItems - 1) + 1;
+                // keys colliding with the last slot went to the buffer, where an empty slot of the new node would hide them
+                std::vector<payload> overflow;
+                buffer->lookupRange(new_first_key, std::numeric_limits<KeyType>::max(), overflow);
+                if (!overflow.empty())
+                {
+                    if (overflow.back().first == std::numeric_limits<KeyType>::max())
+                    {
+                        last_lock.writeUnlock();
+                        return;
+                    }
+                    new_first_key = overflow.back().first + 1;
+                }
+            }
+
+            Node *newNode = allocNode();
+            newNode->numInserts = newNode->numInsertToData = 0;
+            newNode->numItems = last->numItems;
+            newNode->expandNode = nullptr;
+            newNode->expand = false;
+            new_slots(newNode, newNode->numItems);
+            const int bitmap_size = BITMAP_SIZE(newNode->numItems);
+            newNode->noneBitmap = new_bitmap(bitmap_size);
+            memset(newNode->noneBitmap, 0xff, sizeof(bitmap_t) * bitmap_size);
+            newNode->model.a = last->model.a;
+            newNode->model.b = 0.0 - new_first_key * newNode->model.a;
+            newNode->fastPointerIndex = 0;
+
+            // the old last node needs its fast pointer before lookups stop treating it as the last node
+            int fast_pointer_index = 0;
+            if (USE_FAST_POINTER)
+            {
+                buffer->build_fast_pointer(first_key, new_first_key, fast_pointer_index);
+            }
+            last->fastPointerIndex = fast_pointer_index;
+            directory.append(new_first_key, newNode);
+
+            last_lock.writeUnlock();
+        }
+
+        // allocate space for nodes
+        std::allocator<Node> nodeAllocator;
+        Node *new_nodes(int n)
+        {
+            Node *p = nodeAllocator.allocate(n);
+            RT_ASSERT(p != NULL && p != (Node *)(-1));
+            // the allocator returns raw memory, which may hold a taken lock
+            for (int i = 0; i < n; i++)
+            {
+                new (&p[i].expandLock) spin_lock();
+                new (&p[i].fastRanges) std::atomic<FastRanges *>(nullptr);
+                p[i].bufferReads = 0;
+            }
+            return p;
+        }
+        // deallocate space foe nodes
+        static void delete_nodes(Node *p, int n)
+        {
+            std::allocator<Node>().deallocate(p, n);
+        }
+
+        // allocate space for items
+        std::allocator<Item> itemAllocator;
+        Item *new_items(int n)
+        {
+            Item *p = itemAllocator.allocate(n);
+            for (int i = 0; i < n; i++)
+            {
+                p[i].typeVersionLockObsolete = 0b100;
+            }
+            RT_ASSERT(p != NULL && p != (Item *)(-1));
+            return p;
+        }
+
+        // deallocate space for items
+        static void delete_items(Item *p, int n)
+        {
+            std::allocator<Item>().deallocate(p, n);
+        }
+
+        // allocate a cache line aligned array
+        template <class T>
+        T *new_aligned_array(int n)
+        {
+            T *p = static_cast<T *>(aligned_alloc(64, (sizeof(T) * n + 63) / 64 * 64));
+            RT_ASSERT(p != NULL);
+            return p;
+        }
+
+        // allocate the cleared slots of a node in the configured layout
+        void new_slots(Node *node, int n)
+        {
+#if USE_SOA_LAYOUT
+            node->keys = new_aligned_array<KeyType>(n);
+            node->values = new_aligned_array<ValueType>(n);
+            node->locks = new_aligned_array<SlotLock>(SOA_LOCK_NUM(n));
+            memset(node->keys, 0, sizeof(KeyType) * n);
+            memset(node->values, 0, sizeof(ValueType) * n);
+            memset(node->locks, 0, sizeof(SlotLock) * SOA_LOCK_NUM(n));
+#else
+            node->items = new_items(n);
+            memset(node->items, 0, sizeof(Item) * n);
+#endif
+        }
+
+        // deallocate the slots of a node
+        static void delete_slots(Node *node)
+        {
+#if USE_SOA_LAYOUT
+            free(node->keys);
+            free(node->values);
+            free(node->locks);
+#else
+            delete_items(node->items, node->numItems);
+#endif
+        }
+
+        // bytes used by the slots of a node
+        static long long slot_bytes(int n)
+        {
+#if USE_SOA_LAYOUT
+            return (sizeof(KeyType) + sizeof(ValueType)) * static_cast<long long>(n) + sizeof(SlotLock) * SOA_LOCK_NUM(n);
+#else
+            return sizeof(Item) * static_cast<long long>(n);
+#endif
+        }
+
+        // allocate space for bitmap
+        std::allocator<bitmap_t> bitmapAllocator;
+        bitmap_t *new_bitmap(int n)
+        {
+            bitmap_t *p = bitmapAllocator.allocate(n);
+            RT_ASSERT(p != NULL && p != (bitmap_t *)(-1));
+            return p;
+        }
+
+        // deallocate space for bitmap
+        static void delete_bitmap(bitmap_t *p, int n)
+        {
+            std::allocator<bitmap_t>().deallocate(p, n);
+        }
+
+        // free a node retired from the directory, with its slots and bitmap
+        static void freeNode(void *retired)
+        {
+            Node *node = static_cast<Node *>(retired);
+            delete_slots(node);
+            delete_bitmap(node->noneBitmap, BITMAP_SIZE(node->numItems));
+            delete_nodes(node, 1);
+        }
+
+        // free a node replaced in the directory once no reader can reach it, called while holding a guard
+        // and the expand lock of the node, which stays held so that no retraining of the node is queued anymore
+        void retireNode(Node *node)
+        {
+            retiredNodes.fetch_add(1, std::memory_order_release);
+            retire(node, freeNode);
+        }
+
+        /**
+         * @brief Locate a key in the local search window after its predicted slot, without validation.
+         * @param node Node
+         * @param predict_pos Predicted slot of the key
+         * @param key Key
+         * @return Position of the slot holding the key, -1 if it is not in the window.
+         */
+        inline int windowPosition(Node *node, const int &predict_pos, const KeyType &key)
+        {
+            const int start = predict_pos + 1;
+            const int len = std::min(LOCAL_SEARCH_WINDOW, node->numItems - start);
+            if (len <= 0)
+                return -1;
+#if USE_SOA_LAYOUT
+            // keys of the window are contiguous
+            if (sizeof(KeyType) == 8)
+            {
+                int pos = start + avx_linear_search(&node->slotKey(start), len, key);
+                return node->slotKey(pos) == key ? pos : -1;
+            }
+#endif
+            for (int pos = start; pos < start + len; pos++)
+            {
+                if (node->slotKey(pos) == key)
+                    return pos;
+            }
+            return -1;
+        }
+
+        /**
+         * @brief Find a key in the local search window after its predicted slot.
+         * @param value Value of the key if found
+         * @param needRestart Set if the slot changed while it was read
+         * @return True if the key is found in the window.
+         */
+        bool searchWindow(Node *node, const int &predict_pos, const KeyType &key, ValueType &value, bool &needRestart)
+        {
+            const int pos = windowPosition(node, predict_pos, key);
+            if (pos < 0)
+                return false;
+
+            auto v = node->slotLock(pos).readLockOrRestart(needRestart);
+            if (needRestart)
+                return false;
+            if (BITMAP_GET(node->noneBitmap, pos) || node->slotKey(pos) != key)
+                return false;
+            value = node->slotValue(pos);
+            node->slotLock(pos).readUnlockOrRestart(v, needRestart);
+            return !needRestart;
+        }
+
+        /**
+         * @brief Update the value of a key in the local search window after its predicted slot.
+         * @param needRestart Set if the slot changed while it was locked
+         * @return True if the key is found in the window and updated.
+         */
+        bool updateWindow(Node *node, const int &predict_pos, const KeyType &key, const ValueType &value, bool &needRestart)
+        {
+            const int pos = windowPosition(node, predict_pos, key);
+            if (pos < 0)
+                return false;
+
+            auto v = node->slotLock(pos).readLockOrRestart(needRestart);
+            if (needRestart)
+                return false;
+            if (BITMAP_GET(node->noneBitmap, pos) || node->slotKey(pos) != key)
+                return false;
+            node->slotLock(pos).upgradeToWriteLockOrRestart(v, needRestart);
+            if (needRestart)
+                return false;
+            node->slotValue(pos) = value;
+            node->slotLock(pos).writeUnlock();
+            return true;
+        }
+
+        /**
+         * @brief Remove a key from the local search window after its predicted slot.
+         *        The slot keeps occupied with a zero key, like a removed predicted slot.
+         * @param needRestart Set if the slot changed while it was locked
+         * @return True if the key is found in the window and removed.
+         */
+        bool removeFromWindow(Node *node, const int &predict_pos, const KeyType &key, bool &needRestart)
+        {
+            const int pos = windowPosition(node, predict_pos, key);
+            if (pos < 0)
+                return false;
+
+            auto v = node->slotLock(pos).readLockOrRestart(needRestart);
+            if (needRestart)
+                return false;
+            if (BITMAP_GET(node->noneBitmap, pos) || node->slotKey(pos) != key)
+                return false;
+            node->slotLock(pos).upgradeToWriteLockOrRestart(v, needRestart);
+            if (needRestart)
+                return false;
+            node->slotKey(pos) = 0;
+            node->slotLock(pos).writeUnlock();
+            return true;
+        }
+
+        /**
+         * @brief Write a key to a free slot in the local search window after its predicted slot.
+         *        Empty slots and removed (zero key) slots are free. The predicted slot is validated
+         *        against the caller's read version while the free slot is held, so a key is never
+         *        written behind an eviction sweep that has already passed the predicted slot.
+         * @param predict_version Read version of the predicted slot held by the caller
+         * @param needRestart Set if a slot changed while it was claimed
+         * @return True if the key is written.
+         */
+        bool insertToWindow(Node *node, const int &predict_pos, uint64_t &predict_version, const KeyType &key,
+                            const ValueType &value, bool &needRestart)
+        {
+            const int end = std::min(predict_pos + 1 + LOCAL_SEARCH_WINDOW, node->numItems);
+            for (int pos = predict_pos + 1; pos < end; pos++)
+            {
+                if (!BITMAP_GET(node->noneBitmap, pos) && node->slotKey(pos) != 0)
+                    continue;
+
+                if (&node->slotLock(pos) == &node->slotLock(predict_pos))
+                {
+                    // the slot shares the lock of the predicted slot
+                    node->slotLock(pos).upgradeToWriteLockOrRestart(predict_version, needRestart);
+                    if (needRestart)
+                        return false;
+                }
+                else
+                {
+                    auto v = node->slotLock(pos).readLockOrRestart(needRestart);
+                    if (needRestart)
+                        return false;
+                    if (!BITMAP_GET(node->noneBitmap, pos) && node->slotKey(pos) != 0)
+                        continue;
+                    node->slotLock(pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                        return false;
+                    node->slotLock(predict_pos).checkOrRestart(predict_version, needRestart);
+                    if (needRestart)
+                    {
+                        node->slotLock(pos).writeUnlock();
+                        return false;
+                    }
+                }
+                BITMAP_CLEAR(node->noneBitmap, pos);
+                node->slotKey(pos) = key;
+                node->slotValue(pos) = value;
+                node->slotLock(pos).writeUnlock();
+                return true;
+            }
+            return false;
+        }
+
+        // calculate the expected position within a GPL model, of a node or of a frozen node
+        template <class NodeType>
+        static inline int expected_position(const NodeType *node, const KeyType &key)
+        {
+            int ret = node->model.predict(key);
+            int last_slot = node->numItems - 1;
+
+            if (ret < 0)
+            {
+                return 0;
+            }
+
+            return (ret > last_slot) ? last_slot : ret;
+        }
+
+    public:
+        // bulk load data in pairs
+        typedef std::pair<KeyType, ValueType> payload;
+
+        /**
+         * @brief Constructor to initialize the index structure.
+         * @param router_type The way the top level locates the GPL node of a key
+         */
+        explicit AltIndex(RouterType router_type = RouterType::BinarySearch)
+            : directory(router_type), retrainer(USE_ASYNC_RETRAIN ? RETRAIN_THREAD_NUM : 0), gplEpsilon(0)
+        {
+            Node *node = nullptr;
+            for (int i = 0; i < PREALLOC_NODE_NUMS; i++)
+            {
+                node = new_nodes(1);
+                node->numInserts = node->numInsertToData = 0;
+                node->fastPointerIndex = 0;
+                node->expandNode = nullptr;
+                node->expand = false;
+                nodePool.push(node);
+            }
+            root = build_tree_none();
+
+            buffer_num = 0;
+            wal = nullptr;
+
+            // init the art
+            buffer = new artInterface<KeyType, ValueType>();
+        }
+
+        /**
+         * @brief Destructor to release memory.
+         */
+        ~AltIndex()
+        {
+            retrainer.drain();
+            DirectoryVersion *version = directory.current();
+            for (int i = 0; i < version->getSize(); i++)
+            {
+                Node *temp = version->node(i);
+                destroyNode(temp);
+            }
+            for (FastRanges *ranges : builtFastRanges)
+                delete ranges;
+        }
+
+        /**
+         * @brief Insert a key-value pair into the index.
+         * @param kv Key-value pair
+         * @return True if insertion is successful, false otherwise.
+         */
+        bool insert(const payload &kv)
+        {
+            return insert(kv.first, kv.second);
+        }
+
+        // log a write that has been applied and wait for its group commit, failed writes are not logged
+        bool logged(WalOp op, const KeyType &key, const ValueType &value, bool applied)
+        {
+            if (wal == nullptr || !applied)
+                return applied;
+            wal->append(op, key, value);
+            return wal->commit();
+        }
+
+        /**
+         * @brief Insert a batch of key-value pairs into the index.
+         *        The batch is sorted and split into groups of keys that fall into the same GPL node,
+         *        so each node is located once, its slots are filled in one pass with a single
+         *        numInserts update, and its conflicting keys are sent to the buffer together.
+         *        Groups that would trigger dynamic retraining, and the group of the last node, fall back to insert().
+         *        With a write-ahead log the batch is logged and committed once it is in the index.
+         * @param kv Array of key-value pairs
+         * @param n Number of key-value pairs
+         * @return True if insertion is successful, false otherwise.
+         */
+        bool insertBatch(const payload *kv, size_t n)
+        {
+            EpochGuard guard;
+            std::vector<payload> sorted(kv, kv + n);
+            std::sort(sorted.begin(), sorted.end(), [](const payload &a, const payload &b)
+                      { return a.first < b.first; });
+
+            std::vector<payload> conflicts;
+            size_t group_start = 0;
+            while (group_start < n)
+            {
+                const KeyType &first_key = sorted[group_start].first;
+                DirectoryVersion *version = directory.current();
+                const int node_num = version->getSize();
+                const int node_pos = version->route(first_key, node_num);
+
+                // keys routed to the same node are contiguous in the sorted batch
+                size_t group_end = group_start + 1;
+                if (node_pos < node_num - 1)
+                {
+                    const KeyType &next_node_key = version->keys[node_pos + 1];
+                    while (group_end < n && sorted[group_end].first < next_node_key)
+                        group_end++;
+                }
+                else
+                {
+                    group_end = n;
+                }
+                const int group_size = static_cast<int>(group_end - group_start);
+
+                Node *node = version->node(node_pos);
+                // nodes are appended after the last node, whose keys go through insert() to stay in sync;
+                // the expand lock keeps the node from being retrained while the group goes into it
+                if (node_pos == node_num - 1 ||
+                    (USE_DYNAMIC_RETRAIN && (node->expand || node->numInserts + group_size > node->numItems)) ||
+                    !node->expandLock.try_lock())
+                {
+                    for (size_t i = group_start; i < group_end; i++)
+                    {
+                        applyInsert(sorted[i].first, sorted[i].second);
+                    }
+                    group_start = group_end;
+                    continue;
+                }
+
+                conflicts.clear();
+                for (size_t i = group_start; i < group_end; i++)
+                {
+                    const KeyType &key = sorted[i].first;
+                    int predict_pos = expected_position(node, key);
+
+                restart:
+                    bool needRestart = false;
+                    auto v = node->slotLock(predict_pos).readLockOrRestart(needRestart);
+                    if (needRestart)
+                        goto restart;
+
+                    if (BITMAP_GET(node->noneBitmap, predict_pos) ||
+                        (USE_DYNAMIC_RETRAIN && node->slotKey(predict_pos) == 0))
+                    {
+                        node->slotLock(predict_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                        if (needRestart)
+                            goto restart;
+                        BITMAP_CLEAR(node->noneBitmap, predict_pos);
+                        node->slotKey(predict_pos) = key;
+                        node->slotValue(predict_pos) = sorted[i].second;
+                        node->slotLock(predict_pos).writeUnlock();
+                    }
+                    else if (USE_LOCAL_SEARCH && insertToWindow(node, predict_pos, v, key, sorted[i].second, needRestart))
+                    {
+                        continue;
+                    }
+                    else
+                    {
+                        if (needRestart)
+                            goto restart;
+                        conflicts.push_back(sorted[i]);
+                    }
+                }
+                node->numInserts += group_size;
+
+                if (!conflicts.empty())
+                {
+                    insertBatchToBuffer(node_pos, conflicts.data(), conflicts.size(), node);
+                }
+                node->expandLock.unlock();
+                group_start = group_end;
+            }
+            if (wal != nullptr)
+            {
+                // one group commit for the whole batch
+                for (const payload &kv : sorted)
+                    wal->append(WalOp::Insert, kv.first, kv.second);
+                return wal->commit();
+            }
+            return true;
+        }
+
+        /**
+         * @brief Insert a key-value pair into the index. With a write-ahead log, the insert is logged and
+         *        committed before the call returns.
+         * @param key Key
+         * @param value Value
+         * @return True if insertion is successful, false otherwise or if the log failed to write it.
+         */
+        bool insert(const KeyType &key, const ValueType &value)
+        {
+            return logged(WalOp::Insert, key, value, applyInsert(key, value));
+        }
+
+        /**
+         * @brief Insert a key-value pair into the index without logging it, e.g. when replaying the log.
+         * @param key Key
+         * @param value Value
+         * @return True if insertion is successful, false otherwise.
+         */
+        bool applyInsert(const KeyType &key, const ValueType &value)
+        {
+            EpochGuard guard;
+            bool ok = false;
+
+        restart:
+            DirectoryVersion *version = directory.current();
+            const int node_num = version->getSize();
+            const int node_pos = version->route(key, node_num);
+
+            Node *node = version->node(node_pos);
+
+            int predict_pos = expected_position(node, key);
+
+            // read lock
+            bool needRestart = false;
+            auto v = node->slotLock(predict_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+                goto restart;
+            // a node appended after the last one takes over the keys past its range, see appendNode()
+            if (node_pos == node_num - 1 && directory.size() != node_num)
+                goto restart;
+
+            // insert to dynamic retrain buffer
+            if (USE_DYNAMIC_RETRAIN && node->expand)
+            {
+                node->slotLock(predict_pos).checkOrRestart(v, needRestart);
+                if (needRestart)
+                    goto restart;
+                // std::cout << "haha1" << std::endl;
+                if (BITMAP_GET(node->noneBitmap, predict_pos))
+                {
+                    // std::cout << "haha2" << std::endl;
+                    #ifdef DEBUG
+                    if(key == 678844549){
+                        std::cout << "insert to expand node" << key << std::endl;
+                    }
+                    #endif
+                    insertToExpand(node->expandNode, node_pos, key, value);
+                }
+                else
+                {
+                    // std::cout << "haha3" << std::endl;
+                    #ifdef DEBUG
+                    // if(key == 678844549){
+                        std::cout << "insert to data node" << key << std::endl;
+                    // }
+                    #endif
+                    //first evict data at old position, and insert new data to expand node
+                    node->slotLock(predict_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                    {
+                        goto restart;
+                    }
+                    evictData(node, node_pos, predict_pos);
+                    BITMAP_SET(node->noneBitmap, predict_pos);
+                    node->slotLock(predict_pos).writeUnlock();
+                    // if(node_pos == 143 && predict_pos <= 3){
+                    //     std::cout << "warning key: " << key << "predict pos: " << predict_pos << std::endl;
+                    // }
+                    insertToExpand(node->expandNode, node_pos, key, value);
+                }
+                node->numInserts++;
+                ok = true;
+            }
+            else
+            {   // no expand
+                if (BITMAP_GET(node->noneBitmap, predict_pos))
+                {
+                    // write lock
+                    node->slotLock(predict_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                    {
+                        //                        node->slotLock(predict_pos).writeUnlock();
+                        goto restart;
+                    }
+                    BITMAP_CLEAR(node->noneBitmap, predict_pos);
+                    node->slotKey(predict_pos) = key;
+                    node->slotValue(predict_pos) = value;
+                    node->slotLock(predict_pos).writeUnlock();
+                    #ifdef DEBUG
+                    // if(key == 678844549){
+                        std::cout << "insert to gpl model" << key << std::endl;
+                    // }
+                    #endif
+                }
+                else
+                {
+                    if (USE_DYNAMIC_RETRAIN && node->slotKey(predict_pos) == 0)
+                    {
+                        node->slotLock(predict_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                        if (needRestart)
+                        {
+                            goto restart;
+                        }
+                        BITMAP_CLEAR(node->noneBitmap, predict_pos);
+                        node->slotKey(predict_pos) = key;
+                        node->slotValue(predict_pos) = value;
+                        node->slotLock(predict_pos).writeUnlock();
+                        #ifdef DEBUG
+                        // if(key == 678844549){
+                            std::cout << "insert to gpl model sparse slots" << key << std::endl;
+                        // }
+                        #endif
+                    }
+                    else if (USE_LOCAL_SEARCH && insertToWindow(node, predict_pos, v, key, value, needRestart))
+                    {
+                        #ifdef DEBUG
+                            std::cout << "insert to gpl model local window" << key << std::endl;
+                        #endif
+                    }
+                    else
+                    {
+                        if (needRestart)
+                        {
+                            goto restart;
+                        }
+                        #ifdef DEBUG
+                        // if(key == 678844549){
+                            std::cout << "node position: " << node_pos << " insert to art" << key << " index :" << predict_pos << std::endl;
+                        // }
+                        #endif
+                        // hold the slot so the node is not appended to while the key goes to the buffer
+                        node->slotLock(predict_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                        if (needRestart)
+                        {
+                            goto restart;
+                        }
+                        insertToBuffer(node_pos, key, value, node);
+                        node->slotLock(predict_pos).writeUnlock();
+                    }
+                }
+                node->numInserts++;
+                ok = true;
+            }
+
+            if (USE_DYNAMIC_RETRAIN)
+            {
+                // dynamic retrain, the expand lock is held by the queued task until it finishes
+                if (node->numInserts > node->numItems && node->expand == false && node->expandLock.try_lock())
+                {
+                    if (node->expand == false)
+                    {
+                        const KeyType first_key = version->keys[node_pos];
+                        retrainer.submit([this, node, node_pos, first_key]
+                                         { buildExpandNode(node, node_pos, first_key); });
+                    }
+                    else
+                    {
+                        node->expandLock.unlock();
+                    }
+                }
+                // force evict data
+                if (node->numInserts > 2 * node->numItems && node->expand == true && node->expandLock.try_lock())
+                {
+                    node->numInserts = 0;
+                    retrainer.submit([this, node, node_pos]
+                                     { evictNode(node, node_pos); });
+                }
+            }
+            return ok;
+        }
+
+        /**
+         * @brief Find the value associated with a key in the index.
+         * @param key Key
+         * @param exist Flag to store whether the key exists
+         * @return If the key exists, return its corresponding value; otherwise, return the default value.
+         */
+        ValueType find(const KeyType &key, bool &exist)
+        {
+            EpochGuard guard;
+            DirectoryVersion *version = directory.current();
+            const int node_pos = version->route(key, version->getSize());
+
+            Node *node = version->node(node_pos);
+            int key_pos = expected_position(node, key);
+            return findInNode(node, node_pos, key_pos, key, exist);
+        }
+
+        /**
+         * @brief Find the values associated with a batch of keys in the index.
+         *        Keys are processed in groups of FIND_BATCH_GROUP, and each stage of the lookup
+         *        (node_keys search, node fetch, slot probe) is issued for the whole group with
+         *        prefetches before any of them is resolved, so their cache misses overlap.
+         * @param keys Array of keys
+         * @param n Number of keys
+         * @param out Array to store the value of each key (default value if the key doesn't exist)
+         * @param found Array of flags to store whether each key exists
+         */
+        void findBatch(const KeyType *keys, size_t n, ValueType *out, bool *found)
+        {
+            EpochGuard guard;
+            DirectoryVersion *version = directory.current();
+            const KeyType *arr = version->keys;
+            const intptr_t arr_num = version->getSize();
+
+            intptr_t node_pos[FIND_BATCH_GROUP];
+            Node *node[FIND_BATCH_GROUP];
+            int key_pos[FIND_BATCH_GROUP];
+
+            for (size_t base = 0; base < n; base += FIND_BATCH_GROUP)
+            {
+                const int group = static_cast<int>(std::min<size_t>(FIND_BATCH_GROUP, n - base));
+                const KeyType *group_keys = keys + base;
+
+                // stage 1: branchless binary search over node_keys, one step for all keys at a time
+                if (directory.routerType() != RouterType::BinarySearch)
+                {
+                    for (int j = 0; j < group; j++)
+                        node_pos[j] = version->router->route(arr, arr_num, group_keys[j]);
+                }
+                else if (arr_num == 1)
+                {
+                    for (int j = 0; j < group; j++)
+                        node_pos[j] = 0;
+                }
+                else
+                {
+                    intptr_t step = intptr_t(1) << bsr(arr_num - 1);
+                    for (int j = 0; j < group; j++)
+                    {
+                        node_pos[j] = (arr[arr_num - step - 1] < group_keys[j] ? arr_num - step - 1 : -1);
+                    }
+                    step >>= 1;
+
+                    while (step > 0)
+                    {
+                        for (int j = 0; j < group; j++)
+                        {
+                            __builtin_prefetch(&arr[node_pos[j] + step + (step >> 1)], 0, 0);
+                            __builtin_prefetch(&arr[node_pos[j] + (step >> 1)], 0, 0);
+                        }
+                        for (int j = 0; j < group; j++)
+                        {
+                            node_pos[j] = (arr[node_pos[j] + step] < group_keys[j] ? node_pos[j] + step : node_pos[j]);
+                        }
+                        step >>= 1;
+                    }
+
+                    for (int j = 0; j < group; j++)
+                    {
+                        node_pos[j] += 1;
+                        node_pos[j] = (arr[node_pos[j]] > group_keys[j] ? node_pos[j] - 1 : node_pos[j]);
+                    }
+                }
+
+                // stage 2: fetch the GPL nodes
+                for (int j = 0; j < group; j++)
+                {
+                    if (node_pos[j] < 0)
+                    {
+                        node_pos[j] = 0;
+                    }
+                    __builtin_prefetch(&version->nodes[node_pos[j]], 0, 0);
+                }
+                for (int j = 0; j < group; j++)
+                {
+                    node[j] = version->node(node_pos[j]);
+                    __builtin_prefetch(node[j], 0, 0);
+                }
+
+                // stage 3: predict the slots and fetch them with their bitmap words
+                for (int j = 0; j < group; j++)
+                {
+                    key_pos[j] = expected_position(node[j], group_keys[j]);
+                    __builtin_prefetch(&node[j]->slotKey(key_pos[j]), 0, 0);
+                    __builtin_prefetch(&node[j]->noneBitmap[key_pos[j] / BITMAP_WIDTH], 0, 0);
+                }
+
+                // stage 4: resolve the lookups
+                for (int j = 0; j < group; j++)
+                {
+                    out[base + j] = findInNode(node[j], node_pos[j], key_pos[j], group_keys[j], found[base + j]);
+                }
+            }
+        }
+
+        // find a key whose node and predicted slot are already known
+        ValueType findInNode(Node *node, const int &node_pos, const int &key_pos, const KeyType &key, bool &exist)
+        {
+        // read lock
+        restart:
+            bool needRestart = false;
+            auto v = node->slotLock(key_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+            {
+                // the node has been retrained, route again
+                if (node->slotLock(key_pos).isObsolete())
+                    return find(key, exist);
+                goto restart;
+            }
+            if (BITMAP_GET(node->noneBitmap, key_pos))
+            {
+                if (USE_DYNAMIC_RETRAIN && node->expand)
+                {
+                    // keys in the window are only moved once their own slot is evicted
+                    ValueType ret;
+                    if (USE_LOCAL_SEARCH && searchWindow(node, key_pos, key, ret, needRestart))
+                    {
+                        exist = true;
+                        return ret;
+                    }
+                    if (needRestart)
+                        goto restart;
+                    return searchInExpand(node->expandNode, exist, node_pos, key);
+                }
+                else
+                {
+                    // if(key == 349517445){
+                    //     std::cout << "node position: " << node_pos << " not found " << key << "position:" << key_pos << std::endl;
+                    // }
+                    exist = false;
+                    return static_cast<ValueType>(0);
+                }
+            }
+            else
+            {
+                // key exist in node
+                if (node->slotKey(key_pos) == key)
+                {
+                    node->slotLock(key_pos).readUnlockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+
+                    exist = true;
+                    return node->slotValue(key_pos);
+                }
+                else
+                {
+                    ValueType ret;
+                    if (USE_LOCAL_SEARCH && searchWindow(node, key_pos, key, ret, needRestart))
+                    {
+                        exist = true;
+                        return ret;
+                    }
+                    if (needRestart)
+                        goto restart;
+
+                    if (USE_DYNAMIC_RETRAIN && node->expand)
+                    {
+                        return searchInExpand(node->expandNode, exist, node_pos, key);
+                    }
+
+                    ret = searchInBuffer(node_pos, key, exist, node);
+                    // a retrain may have moved the key from the buffer to a slot meanwhile
+                    if (USE_SEGMENT_RETRAIN && !exist)
+                    {
+                        node->slotLock(key_pos).checkOrRestart(v, needRestart);
+                        if (needRestart)
+                            goto restart;
+                    }
+                    return ret;
+                }
+            }
+            return static_cast<ValueType>(0);
+        }
+
+        /**
+         * @brief Update the value associated with a key in the index.
+         * @param key Key
+         * @param value New value
+         * @return True if the update is successful, false otherwise.
+         */
+        bool update(const KeyType &key, const ValueType &value)
+        {
+            return logged(WalOp::Update, key, value, applyUpdate(key, value));
+        }
+
+        /**
+         * @brief Update the value of a key without logging it.
+         * @param key Key
+         * @param value New value
+         * @return True if the update is successful, false otherwise.
+         */
+        bool applyUpdate(const KeyType &key, const ValueType &value)
+        {
+            EpochGuard guard;
+        restart:
+            DirectoryVersion *version = directory.current();
+            const int node_pos = version->route(key, version->getSize());
+
+            Node *node = version->node(node_pos);
+            int key_pos = expected_position(node, key);
+            // read lock
+            bool needRestart = false;
+            auto v = node->slotLock(key_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+                goto restart;
+            if (BITMAP_GET(node->noneBitmap, key_pos))
+            {
+                if (USE_DYNAMIC_RETRAIN && node->expand)
+                {
+                    if (USE_LOCAL_SEARCH && updateWindow(node, key_pos, key, value, needRestart))
+                        return true;
+                    if (needRestart)
+                        goto restart;
+                    return updateInExpand(node->expandNode, node_pos, key, value);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                // key exist in node
+                if (node->slotKey(key_pos) == key)
+                {
+                    node->slotLock(key_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+                    node->slotValue(key_pos) = value;
+                    node->slotLock(key_pos).writeUnlock();
+                    return true;
+                }
+                else
+                {
+                    if (USE_LOCAL_SEARCH && updateWindow(node, key_pos, key, value, needRestart))
+                        return true;
+                    if (needRestart)
+                        goto restart;
+
+                    if (USE_DYNAMIC_RETRAIN && node->expand)
+                    {
+                        return updateInExpand(node->expandNode, node_pos, key, value);
+                    }
+
+                    // hold the slot so that a retrain doesn't move the key out of the buffer meanwhile
+                    node->slotLock(key_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+                    bool ok = buffer->update(key, value);
+                    node->slotLock(key_pos).writeUnlock();
+                    return ok;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Remove a key-value pair from the index.
+         * @param key Key
+         * @return True if removal is successful, false otherwise.
+         */
+        bool remove(const KeyType &key)
+        {
+            return logged(WalOp::Remove, key, ValueType(), applyRemove(key));
+        }
+
+        /**
+         * @brief Remove a key-value pair from the index without logging it.
+         * @param key Key
+         * @return True if removal is successful, false otherwise.
+         */
+        bool applyRemove(const KeyType &key)
+        {
+            EpochGuard guard;
+            bool ok = true;
+
+        restart:
+            DirectoryVersion *version = directory.current();
+            const int node_pos = version->route(key, version->getSize());
+
+            Node *node = version->node(node_pos);
+            int predict_pos = expected_position(node, key);
+
+            bool needRestart = false;
+            // read lock
+            auto v = node->slotLock(predict_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+                goto restart;
+
+            // data doesn't exist
+            if (BITMAP_GET(node->noneBitmap, predict_pos))
+            {
+                return ok;
+            }
+            else
+            {
+                if (USE_LOCAL_SEARCH && node->slotKey(predict_pos) != key)
+                {
+                    if (removeFromWindow(node, predict_pos, key, needRestart))
+                        return ok;
+                    if (needRestart)
+                        goto restart;
+                }
+
+                // write lock
+                node->slotLock(predict_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                if (needRestart)
+                {
+                    //                    node->slotLock(predict_pos).writeUnlock();
+                    goto restart;
+                }
+
+                if (node->slotKey(predict_pos) == key)
+                {
+                    node->slotKey(predict_pos) = 0;
+                    node->slotLock(predict_pos).writeUnlock();
+                }
+                else
+                {
+                    // the slot is held so that a retrain doesn't move the key out of the buffer meanwhile
+                    if (USE_FAST_POINTER)
+                        ok = buffer->fast_remove(key, node->fastPointerIndex);
+                    else
+                        ok = buffer->remove(key);
+                    node->slotLock(predict_pos).writeUnlock();
+                    if (USE_STATISTIC)
+                    {
+                        if (ok)
+                            buffer_num--;
+                    }
+                }
+            }
+            return ok;
+        }
+
+        /**
+         * @brief Forward iterator over the keys of a range in key order. It takes the GPL nodes one at a time and
+         *        merges the live slots of a node and of its expand nodes with the buffered records of its key range,
+         *        which are read in batches of LOOKUP_RANGE_BATCH, so it neither locks nor copies the whole range.
+         *        A node that is retrained meanwhile is read again from the first key not returned yet, as is
+         *        the node of a call after nodes have been retired, since the old chain may have been freed.
+         *        Keys inserted or removed during the scan may or may not be returned, the others are returned once.
+         */
+        class Iterator
+        {
+        public:
+            bool valid() const { return !done; }
+            const KeyType &key() const { return current.first; }
+            const ValueType &value() const { return current.second; }
+            void next() { advance(); }
+
+        private:
+            friend class AltIndex;
+
+            Iterator(AltIndex *index, const KeyType &start, const KeyType &end)
+                : index(index), endKey(end), done(end < start), seenRetired(0)
+            {
+                if (!done)
+                {
+                    load(start);
+                    advance();
+                }
+            }
+
+            // read the keys of the node of from, from it on
+            void load(const KeyType &from)
+            {
+                EpochGuard guard;
+            restart:
+                seenRetired = index->retiredNodes.load(std::memory_order_acquire);
+                DirectoryVersion *version = index->directory.current();
+                const int node_num = version->getSize();
+                const int node_pos = version->route(from, node_num);
+                lastRange = node_pos == node_num - 1 || !(version->keys[node_pos + 1] - 1 < endKey);
+                rangeLast = lastRange ? endKey : version->keys[node_pos + 1] - 1;
+                resumeKey = from;
+                rangeEnded = false;
+
+                // a retrain locks all slots of the node and its expand nodes, see validate()
+                bool needRestart = false;
+                chain.clear();
+                versions.clear();
+                for (Node *cur = version->node(node_pos); cur != nullptr; cur = cur->expand ? cur->expandNode : nullptr)
+                {
+                    const uint64_t v = cur->slotLock(0).readLockOrRestart(needRestart);
+                    if (needRestart)
+                        goto restart;
+                    chain.push_back(cur);
+                    versions.push_back(v);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                }
+
+                slots.clear();
+                for (Node *cur : chain)
+                {
+                    // the models are monotonic and search windows follow the predicted slot, so keys from
+                    // on sit after the predicted slot of from
+                    OccupiedSlots occupied(cur->noneBitmap, index->expected_position(cur, from), cur->numItems);
+                    for (int pos = occupied.next(); pos < cur->numItems; pos = occupied.next())
+                    {
+                        bool live;
+                        KeyType key;
+                        ValueType value;
+                        do
+                        {
+                            needRestart = false;
+                            const uint64_t v = cur->slotLock(pos).readLockOrRestart(needRestart);
+                            if (needRestart)
+                            {
+                                if (cur->slotLock(pos).isObsolete())
+                                    goto restart;
+                                continue;
+                            }
+                            live = !BITMAP_GET(cur->noneBitmap, pos);
+                            key = cur->slotKey(pos);
+                            value = cur->slotValue(pos);
+                            cur->slotLock(pos).readUnlockOrRestart(v, needRestart);
+                        } while (needRestart);
+                        // removed keys leave 0 in their slot
+                        if (live && key != static_cast<KeyType>(0) && !(key < from) && !(rangeLast < key))
+                            slots.push_back({key, value});
+                    }
+                }
+                // slots are not in key order across expand nodes and search windows, and an eviction may
+                // have moved a key to an expand node after its old slot was read
+                std::sort(slots.begin(), slots.end(), [](const payload &a, const payload &b)
+                          { return a.first < b.first; });
+                slots.erase(std::unique(slots.begin(), slots.end(), [](const payload &a, const payload &b)
+                                        { return a.first == b.first; }),
+                            slots.end());
+                slotPos = 0;
+
+                if (!fetchBuffer(from))
+                    goto restart;
+            }
+
+            // read the next batch of buffered records of the node range, false if the node has been retrained
+            bool fetchBuffer(const KeyType &from)
+            {
+                buffered.resize(LOOKUP_RANGE_BATCH);
+                const size_t n = index->buffer->lookupRange(from, rangeLast, buffered.data(), LOOKUP_RANGE_BATCH);
+                buffered.resize(n);
+                bufferPos = 0;
+                bufferMore = n == LOOKUP_RANGE_BATCH && buffered.back().first < rangeLast;
+                return validate();
+            }
+
+            // a retrain moves keys between the buffer and the slots with all slots locked
+            bool validate() const
+            {
+                bool needRestart = false;
+                for (size_t i = 0; i < chain.size() && !needRestart; i++)
+                {
+                    chain[i]->slotLock(0).checkOrRestart(versions[i], needRestart);
+                }
+                return !needRestart;
+            }
+
+            void advance()
+            {
+                while (true)
+                {
+                    if (!rangeEnded)
+                    {
+                        if (bufferPos == buffered.size() && bufferMore)
+                        {
+                            // the nodes of the chain are freed once retired and no call holds a guard
+                            EpochGuard guard;
+                            if (index->retiredNodes.load(std::memory_order_acquire) != seenRetired ||
+                                !fetchBuffer(buffered.back().first + 1))
+                            {
+                                load(resumeKey);
+                                continue;
+                            }
+                        }
+                        const bool inSlots = slotPos < slots.size(), inBuffer = bufferPos < buffered.size();
+                        if (inSlots || inBuffer)
+                        {
+                            if (inSlots && (!inBuffer || !(buffered[bufferPos].first < slots[slotPos].first)))
+                            {
+                                // a retrain has copied the key to a slot and not removed it from the buffer yet
+                                if (inBuffer && buffered[bufferPos].first == slots[slotPos].first)
+                                    bufferPos++;
+                                current = slots[slotPos++];
+                            }
+                            else
+                            {
+                                current = buffered[bufferPos++];
+                            }
+                            if (current.first == rangeLast)
+                                rangeEnded = true;
+                            else
+                                resumeKey = current.first + 1;
+                            return;
+                        }
+                    }
+                    if (lastRange)
+                    {
+                        done = true;
+                        return;
+                    }
+                    load(rangeLast + 1);
+                }
+            }
+
+            AltIndex *index;
+            KeyType endKey;
+            bool done;
+            payload current;
+            KeyType rangeLast;             // last key of the node range within the scan
+            bool lastRange;                // no node range follows within the scan
+            KeyType resumeKey;             // first key of the node range not returned yet
+            bool rangeEnded;               // rangeLast has been returned
+            std::vector<Node *> chain;     // the node and its expand nodes
+            std::vector<uint64_t> versions; // of the first slot lock of each node of the chain
+            std::vector<payload> slots;    // live slots of the chain from the scan position, in key order
+            std::vector<payload> buffered; // batch of buffered records of the node range
+            size_t slotPos;
+            size_t bufferPos;
+            bool bufferMore;               // the node range may have more buffered records than the batch
+            uint64_t seenRetired;          // retired nodes of the index when the chain was read
+        };
+
+        /**
+         * @brief Iterator over the keys in [start, end] in key order.
+         * @param start First key of the range
+         * @param end Last key of the range
+         * @return Iterator on the first key of the range, invalid if there is none.
+         */
+        Iterator seek(const KeyType &start, const KeyType &end = std::numeric_limits<KeyType>::max())
+        {
+            return Iterator(this, start, end);
+        }
+
+        /**
+         * @brief Call a function on the key-value pairs in [start, end] in key order.
+         * @param start First key of the range
+         * @param end Last key of the range
+         * @param callback Called as callback(key, value), the scan stops once it returns false
+         * @return The number of key-value pairs passed to the callback.
+         */
+        template <typename Callback>
+        size_t scan(const KeyType &start, const KeyType &end, Callback callback)
+        {
+            size_t count = 0;
+            for (Iterator it = seek(start, end); it.valid(); it.next())
+            {
+                count++;
+                if (!callback(it.key(), it.value()))
+                    break;
+            }
+            return count;
+        }
+
+        /**
+         * @brief Copy the first key-value pairs from a start key on in key order.
+         * @param results Array of at least len pairs
+         * @param start Start key of the range
+         * @param len Most key-value pairs copied
+         * @return The number of key-value pairs copied.
+         */
+        int rangeQuery(std::pair<KeyType, ValueType> *results, const KeyType &start, int len)
+        {
+            int result_count = 0;
+            if (len <= 0)
+                return 0;
+            scan(start, std::numeric_limits<KeyType>::max(), [&](const KeyType &key, const ValueType &value)
+                 {
+                     results[result_count++] = {key, value};
+                     return result_count < len; });
+            return result_count;
+        }
+
+        // write lock all slots of a node in slot order, slots sharing a lock are locked once
+        void lockAllSlots(Node *node)
+        {
+            bool needRestart;
+            for (int i = 0; i < node->numItems; i++)
+            {
+                if (i > 0 && &node->slotLock(i) == &node->slotLock(i - 1))
+                    continue;
+                do
+                {
+                    needRestart = false;
+                    node->slotLock(i).writeLockOrRestart(needRestart);
+                } while (needRestart);
+            }
+        }
+
+        // release all slots of a node locked by lockAllSlots()
+        void unlockAllSlots(Node *node)
+        {
+            for (int i = 0; i < node->numItems; i++)
+            {
+                if (i > 0 && &node->slotLock(i) == &node->slotLock(i - 1))
+                    continue;
+                node->slotLock(i).writeUnlock();
+            }
+        }
+
+        // mark all slots of a node locked by lockAllSlots() obsolete and release them
+        void retireAllSlots(Node *node)
+        {
+            for (int i = 0; i < node->numItems; i++)
+            {
+                if (i > 0 && &node->slotLock(i) == &node->slotLock(i - 1))
+                    continue;
+                node->slotLock(i).labelObsolete();
+                node->slotLock(i).writeUnlock();
+            }
+        }
+
+        /**
+         * @brief Retrain a node: run the GPL segmentation again over its live keys (the slots
+         *        of the node and of its expand nodes, and its range of the buffer) and replace the node
+         *        with one new node per segment. Buffer keys that get a slot are removed from the buffer.
+         *        All slots of the node and its expand nodes stay write locked meanwhile: writers to the
+         *        buffer range of a node hold one of them, and readers recheck theirs after missing in the
+         *        buffer. The slots are then marked obsolete, so that operations still holding the old
+         *        node route again, the expand lock of the old node is kept, and the old nodes are retired.
+         *        Called with node->expandLock held.
+         * @param node Expanded node, or any node when compacting
+         * @param node_pos Position where the node was seen
+         * @param epsilon Error bound of the new segments
+         * @param gaps Gaps of the new nodes, relative to their number of keys
+         * @param stats Compaction counters; if given, a node with less than COMPACTION_MIN_BUFFERED of its
+         *        keys in the buffer is left as it is
+         * @return False if the node is left as it is, because it is the last node or it has no live keys.
+         */
+        bool rebuildNode(Node *node, const int node_pos, const int epsilon, const double gaps,
+                         CompactionStats *stats = nullptr)
+        {
+            DirectoryVersion *version = directory.current();
+            const int pos = directory.position(node, node_pos);
+            // keys past the range of the last node are only known once a node is appended
+            if (pos < 0 || pos == version->getSize() - 1)
+                return false;
+            const KeyType first_key = version->keys[pos];
+            const KeyType next_key = version->keys[pos + 1];
+
+            std::vector<Node *> chain;
+            for (Node *cur = node; cur != nullptr; cur = cur->expand ? cur->expandNode : nullptr)
+            {
+                chain.push_back(cur);
+                lockAllSlots(cur);
+            }
+
+            // live keys, flagged if they are in the buffer
+            std::vector<std::pair<payload, bool>> records;
+            int occupied = 0;
+            for (Node *cur : chain)
+            {
+                occupied += bitmap_count_occupied(cur->noneBitmap, 0, cur->numItems);
+            }
+            records.reserve(occupied);
+            for (Node *cur : chain)
+            {
+                OccupiedSlots slots(cur->noneBitmap, 0, cur->numItems);
+                for (int i = slots.next(); i < cur->numItems; i = slots.next())
+                {
+                    if (cur->slotKey(i) != 0)
+                        records.push_back({{cur->slotKey(i), cur->slotValue(i)}, false});
+                }
+            }
+            std::vector<payload> buffered;
+            buffer->lookupRange(pos == 0 ? std::numeric_limits<KeyType>::min() : first_key, next_key - 1, buffered);
+            for (auto &kv : buffered)
+            {
+                records.push_back({kv, true});
+            }
+            const bool few_buffered = buffered.empty() || buffered.size() < records.size() * COMPACTION_MIN_BUFFERED;
+            if (records.empty() || (stats != nullptr && few_buffered))
+            {
+                for (Node *cur : chain)
+                {
+                    unlockAllSlots(cur);
+                }
+                return false;
+            }
+            std::sort(records.begin(), records.end(), [](const std::pair<payload, bool> &a, const std::pair<payload, bool> &b)
+                      { return a.first.first < b.first.first || (a.first.first == b.first.first && a.second < b.second); });
+
+            // keys array has one spare entry, segmentPartition() reads one key past the segment
+            const int n = static_cast<int>(records.size());
+            KeyType *keys = new KeyType[n + 1];
+            ValueType *values = new ValueType[n + 1];
+            std::vector<char> in_buffer(n);
+            int num = 0;
+            for (int i = 0; i < n; i++)
+            {
+                // a key in a slot and in the buffer keeps the slot value and is removed from the buffer
+                if (num > 0 && keys[num - 1] == records[i].first.first)
+                {
+                    in_buffer[num - 1] = in_buffer[num - 1] || records[i].second;
+                    continue;
+                }
+                keys[num] = records[i].first.first;
+                values[num] = records[i].first.second;
+                in_buffer[num] = records[i].second;
+                num++;
+            }
+            keys[num] = keys[num - 1];
+
+            std::vector<Node *> nodes;
+            std::vector<KeyType> node_keys;
+            std::vector<int> conflicts;
+            long long buffer_after = 0;
+            int used_index = 0;
+            while (used_index < num)
+            {
+                Segment segment;
+                segmentPartition(keys + used_index, num - used_index, segment, epsilon);
+                conflicts.clear();
+                nodes.push_back(bulkLoadNode(keys + used_index, values + used_index, segment, &conflicts, gaps));
+                node_keys.push_back(nodes.size() == 1 ? first_key : static_cast<KeyType>(segment.firstKey));
+
+                // keys without a slot stay in or go to the buffer, the others leave it
+                size_t next_conflict = 0;
+                for (int i = 0; i < segment.numItems; i++)
+                {
+                    const int index = used_index + i;
+                    if (next_conflict < conflicts.size() && conflicts[next_conflict] == i)
+                    {
+                        next_conflict++;
+                        buffer_after++;
+                        if (!in_buffer[index])
+                        {
+                            buffer->put(keys[index], values[index]);
+                            if (USE_STATISTIC)
+                                buffer_num++;
+                        }
+                    }
+                    else if (in_buffer[index])
+                    {
+                        buffer->remove(keys[index]);
+                        if (USE_STATISTIC)
+                            buffer_num--;
+                    }
+                }
+                used_index += segment.numItems;
+            }
+            delete[] keys;
+            delete[] values;
+
+            if (USE_FAST_POINTER)
+            {
+                int ret;
+                for (size_t i = 0; i < nodes.size(); i++)
+                {
+                    buffer->build_fast_pointer(node_keys[i], i + 1 < nodes.size() ? node_keys[i + 1] : next_key, ret);
+                    nodes[i]->fastPointerIndex = ret;
+                }
+            }
+            for (Node *new_node : nodes)
+            {
+                new_node->expandNode = nullptr;
+                new_node->expand = false;
+            }
+
+            const bool replaced = directory.split(node, pos, node_keys.data(), nodes.data(), static_cast<int>(nodes.size()));
+            for (Node *cur : chain)
+            {
+                retireAllSlots(cur);
+                if (replaced)
+                    retireNode(cur);
+            }
+            if (stats != nullptr)
+            {
+                stats->nodes++;
+                stats->newNodes += nodes.size();
+                stats->bufferBefore += buffered.size();
+                stats->bufferAfter += buffer_after;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Build the 2x expand node of a node, later inserts of the node go to the expand node.
+         *        Called with node->expandLock held, which is released here.
+         * @param node Node to be expanded
+         * @param node_pos Position of the node in the directory
+         * @param first_key First key of the node
+         */
+        void buildExpandNode(Node *node, const int node_pos, const KeyType first_key)
+        {
+            EpochGuard guard;
+            Node *expandNode = allocNode();
+
+            expandNode->numInserts = expandNode->numInsertToData = 0;
+            expandNode->numItems = node->numItems * 2;
+            expandNode->expandNode = nullptr;
+            expandNode->expand = false;
+
+            new_slots(expandNode, expandNode->numItems);
+            const int bitmap_size = BITMAP_SIZE(expandNode->numItems);
+            expandNode->noneBitmap = new_bitmap(bitmap_size);
+            memset(expandNode->noneBitmap, 0xff, sizeof(bitmap_t) * bitmap_size);
+            expandNode->model.a = node->model.a * 2.0;
+            expandNode->model.b = 0.0 - first_key * expandNode->model.a;
+
+            if (node_pos == directory.size() - 1)
+            { // last gpl model
+                appendNode(node, first_key);
+            }
+            expandNode->fastPointerIndex = node->fastPointerIndex;
+            expandNode->fastRanges.store(node->fastRanges.load(std::memory_order_acquire), std::memory_order_release);
+
+            node->expandNode = expandNode;
+            // inserts on other threads follow expandNode once they see the flag
+            std::atomic_thread_fence(std::memory_order_release);
+            node->expand = true;
+            node->expandLock.unlock();
+            //    std::cout << "trigger dynamic retraining:" << node_keys[node_pos] << std::endl;
+        }
+
+        /**
+         * @brief Move all slots of an expanded node to its expand node, then put the expand node
+         *        in its place in the directory. Slots are locked one at a time, so inserts and
+         *        lookups of the node go on during the eviction. With USE_SEGMENT_RETRAIN the node
+         *        is retrained by rebuildNode() instead, if it can be.
+         *        Called with node->expandLock held, which is released here unless the node is retired.
+         * @param node Expanded node
+         * @param node_pos Position of the node in the directory
+         */
+        void evictNode(Node *node, const int node_pos)
+        {
+            EpochGuard guard;
+            if (USE_SEGMENT_RETRAIN && rebuildNode(node, node_pos, gplEpsilon, ARR_GAPS))
+                return;
+
+            bool needRestart;
+            for (int i = 0; i < node->numItems; i++)
+            {
+                // concurrent inserts evict slots as well, recheck under the slot lock
+                do
+                {
+                    needRestart = false;
+                    node->slotLock(i).writeLockOrRestart(needRestart);
+                } while (needRestart);
+                if(!BITMAP_GET(node->noneBitmap, i)){
+                    evictData(node, node_pos, i);
+                    BITMAP_SET(node->noneBitmap, i);
+                }
+                node->slotLock(i).writeUnlock();
+            }
+            // update pointer
+            if (directory.replace(node, node->expandNode, node_pos))
+                retireNode(node);
+            else
+                node->expandLock.unlock();
+            // std::cout << "finish expansion" << node_pos << std::endl;
+        }
+
+        // evict the data of the evict_pos of node
+        void evictData(Node *node, const int &node_pos, const int &evict_pos)
+        {
+            // check expand node bitmap and evict the data
+            if(node->slotKey(evict_pos) != 0){
+                #ifdef DEBUG
+                // if(node->slotKey(evict_pos) == 678844549){
+                    std::cout << "evict to expand node" << node->slotKey(evict_pos) << std::endl;
+                // }
+                #endif
+                insertToExpand(node->expandNode, node_pos, node->slotKey(evict_pos), node->slotValue(evict_pos));
+            }
+            BITMAP_CLEAR(node->expandNode->noneBitmap, evict_pos * 2);
+            BITMAP_CLEAR(node->expandNode->noneBitmap, evict_pos * 2 + 1);
+        }
+
+        void insertToExpand(Node *expandNode, const int &node_pos, const KeyType &key, const ValueType &value)
+        {
+            int expand_pos = expected_position(expandNode, key);
+
+        restart:
+            // read lock
+            bool needRestart = false;
+            auto v = expandNode->slotLock(expand_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+            {
+                // the node has been retrained, route again
+                if (expandNode->slotLock(expand_pos).isObsolete())
+                {
+                    applyInsert(key, value);
+                    return;
+                }
+                goto restart;
+            }
+            // a stale caller may reach an expand node that has been expanded and evicted in turn
+            if (USE_DYNAMIC_RETRAIN && expandNode->expand)
+            {
+                expandNode->slotLock(expand_pos).checkOrRestart(v, needRestart);
+                if (needRestart)
+                    goto restart;
+                insertToExpand(expandNode->expandNode, node_pos, key, value);
+                return;
+            }
+            if (BITMAP_GET(expandNode->noneBitmap, expand_pos))
+            {
+                expandNode->slotLock(expand_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                if (needRestart)
+                {
+                    //                    expandNode->slotLock(expand_pos).writeUnlock();
+                    goto restart;
+                }
+
+                BITMAP_CLEAR(expandNode->noneBitmap, expand_pos);
+                expandNode->slotKey(expand_pos) = key;
+                expandNode->slotValue(expand_pos) = value;
+                expandNode->slotLock(expand_pos).writeUnlock();
+                #ifdef DEBUG
+                // if(key == 678844549){
+                    std::cout << "evict and insert to expand node" << key << std::endl;
+                // }
+                #endif
+            }
+            else
+            {
+                // std::cout << "haha5" << std::endl;
+                if(expandNode->slotKey(expand_pos) == 0){
+                    expandNode->slotLock(expand_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                    {
+                        //                    expandNode->slotLock(expand_pos).writeUnlock();
+                        goto restart;
+                    }
+
+                    expandNode->slotKey(expand_pos) = key;
+                    expandNode->slotValue(expand_pos) = value;
+                    expandNode->slotLock(expand_pos).writeUnlock();
+                }
+                else if (!(USE_LOCAL_SEARCH && insertToWindow(expandNode, expand_pos, v, key, value, needRestart))){
+                    if (needRestart)
+                        goto restart;
+                    #ifdef DEBUG
+                    // if(key == 678844549){
+                        std::cout << "evict and insert to buffer" << key << std::endl;
+                    // }
+                    #endif
+                    // writers of the buffer range of a node hold one of its slots, see rebuildNode()
+                    expandNode->slotLock(expand_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+                    insertToBuffer(node_pos, key, value, expandNode);
+                    expandNode->slotLock(expand_pos).writeUnlock();
+                }
+            }
+            expandNode->numInserts++;
+        }
+
+        void insertToBuffer(const int &node_pos, const KeyType &key, const ValueType &value, Node *node)
+        {
+            // insert to buffer
+            if (USE_FAST_POINTER)
+            {
+                if (node_pos < directory.size() - 1)
+                {
+                    // std::cout << "haha6" << std::endl;
+                    // std::cout << node_pos << " " << key << std::endl;
+                    ValueType haha;
+                    // std::cout << buffer->fastGet(key, haha, node->fastPointerIndex) << std::endl;
+                    buffer->fastPut(key, value, node->fastPointerIndex);
+                    if (USE_STATISTIC)
+                    {
+                        buffer_num++;
+                    }
+                }
+                else
+                {
+                    // std::cout << "haha7" << std::endl;
+                    buffer->put(key, value);
+                    if (USE_STATISTIC)
+                    {
+                        buffer_num++;
+                    }
+                }
+            }
+            else
+            {
+                buffer->put(key, value);
+                if (USE_STATISTIC)
+                {
+                    buffer_num++;
+                }
+            }
+        }
+
+        void insertBatchToBuffer(const int &node_pos, const payload *kv, size_t n, Node *node)
+        {
+            if (USE_FAST_POINTER && node_pos < directory.size() - 1)
+            {
+                buffer->bulkFastPut(kv, n, node->fastPointerIndex);
+            }
+            else
+            {
+                buffer->bulkPut(kv, n);
+            }
+            if (USE_STATISTIC)
+            {
+                buffer_num += n;
+            }
+        }
+
+        ValueType searchInExpand(Node *expandNode, bool &exist, const int &node_pos, const KeyType &key)
+        {
+        restart:
+            bool needRestart = false;
+            int expand_pos = expected_position(expandNode, key);
+            auto v = expandNode->slotLock(expand_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+            {
+                // the node has been retrained, route again
+                if (expandNode->slotLock(expand_pos).isObsolete())
+                    return find(key, exist);
+                goto restart;
+            }
+
+            if (BITMAP_GET(expandNode->noneBitmap, expand_pos))
+            {
+                ValueType ret;
+                if (USE_LOCAL_SEARCH && searchWindow(expandNode, expand_pos, key, ret, needRestart))
+                {
+                    exist = true;
+                    return ret;
+                }
+                if (needRestart)
+                    goto restart;
+                if (USE_DYNAMIC_RETRAIN && expandNode->expand)
+                {
+                    return searchInExpand(expandNode->expandNode, exist, node_pos, key);
+                }
+                ret = searchInBuffer(node_pos, key, exist, expandNode);
+                // a retrain may have moved the key from the buffer to a slot meanwhile
+                if (USE_SEGMENT_RETRAIN && !exist)
+                {
+                    expandNode->slotLock(expand_pos).checkOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+                }
+                return ret;
+            }
+            else
+            {
+                // slot is occupied
+                if (expandNode->slotKey(expand_pos) == key)
+                {
+                    expandNode->slotLock(expand_pos).readUnlockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+
+                    exist = true;
+                    return expandNode->slotValue(expand_pos);
+                }
+                else
+                {
+                    ValueType ret_val;
+                    if (USE_LOCAL_SEARCH && searchWindow(expandNode, expand_pos, key, ret_val, needRestart))
+                    {
+                        exist = true;
+                        return ret_val;
+                    }
+                    if (needRestart)
+                        goto restart;
+                    if (USE_DYNAMIC_RETRAIN && expandNode->expand)
+                    {
+                        return searchInExpand(expandNode->expandNode, exist, node_pos, key);
+                    }
+                    // if the fast pointer is invalid
+                    ret_val = searchInBuffer(node_pos, key, exist, expandNode);
+                    if (USE_SEGMENT_RETRAIN && !exist)
+                    {
+                        expandNode->slotLock(expand_pos).checkOrRestart(v, needRestart);
+                        if (needRestart)
+                            goto restart;
+                    }
+                    return ret_val;
+                }
+            }
+        }
+
+        // fast pointer of the sub-range of a key, or of the whole node
+        inline int fastPointerOf(Node *node, const KeyType &key) const
+        {
+            const FastRanges *ranges = node->fastRanges.load(std::memory_order_acquire);
+            if (ranges != nullptr)
+            {
+                const int range = static_cast<int>((static_cast<uint64_t>(key) >> ranges->shift) & 0xff) - ranges->firstByte;
+                if (range >= 0 && range < ranges->num)
+                    return ranges->pointerIndex[range];
+            }
+            return node->fastPointerIndex;
+        }
+
+        // count one in FAST_POINTER_SAMPLE buffer lookups of the thread towards the heat of the node
+        void sampleBufferRead(Node *node, const int fast_pointer_index)
+        {
+            static thread_local uint32_t reads = 0;
+            if (++reads % FAST_POINTER_SAMPLE != 0)
+                return;
+            node->bufferReads++; // racy, it only estimates the heat
+            skippedDepth.fetch_add(buffer->fast_pointer_level(fast_pointer_index), std::memory_order_relaxed);
+            if (sampledReads.fetch_add(1, std::memory_order_relaxed) % FAST_POINTER_ADAPT_PERIOD == FAST_POINTER_ADAPT_PERIOD - 1 &&
+                !adaptQueued.exchange(true))
+            {
+                retrainer.submit([this]
+                                 {
+                                     adaptFastPointers();
+                                     adaptQueued.store(false); });
+            }
+        }
+
+        // the sub-range fast pointers of the keys [first_key, last_key], nullptr if the range spans too many
+        FastRanges *buildFastRanges(const KeyType first_key, const KeyType last_key)
+        {
+            if (!std::is_integral<KeyType>::value || first_key >= last_key)
+                return nullptr;
+            const uint64_t first = static_cast<uint64_t>(first_key), last = static_cast<uint64_t>(last_key);
+            int shift = sizeof(KeyType) * 8 - 8;
+            while (((first ^ last) >> shift) == 0)
+                shift -= 8;
+            const int first_byte = (first >> shift) & 0xff, last_byte = (last >> shift) & 0xff;
+            if (last_byte - first_byte + 1 > FAST_POINTER_MAX_RANGES)
+                return nullptr;
+
+            FastRanges *ranges = new FastRanges();
+            ranges->shift = shift;
+            ranges->firstByte = first_byte;
+            ranges->num = last_byte - first_byte + 1;
+            const uint64_t low_bits = (shift == 0) ? 0 : (~0ULL >> (64 - shift));
+            for (int i = 0; i < ranges->num; i++)
+            {
+                // the keys of the node whose byte at shift is first_byte + i
+                const uint64_t prefix = (first & ~(low_bits | (0xffULL << shift))) | (static_cast<uint64_t>(first_byte + i) << shift);
+                const KeyType low = static_cast<KeyType>(std::max(first, prefix));
+                const KeyType high = static_cast<KeyType>(std::min(last, prefix | low_bits));
+                buffer->build_fast_pointer(low, high, ranges->pointerIndex[i]);
+            }
+            return ranges;
+        }
+
+        ValueType searchInBuffer(const int &node_pos, const KeyType &key, bool &exist, Node *node)
+        {
+            ValueType ret_val;
+            if (USE_FAST_POINTER)
+            {
+                if (node_pos < directory.size() - 1)
+                {
+                    int fast_pointer_index = fastPointerOf(node, key);
+                    if (USE_ADAPTIVE_FAST_POINTER)
+                        sampleBufferRead(node, fast_pointer_index);
+                    if (buffer->fastGet(key, ret_val, fast_pointer_index))
+                    {
+                        exist = true;
+                        return ret_val;
+                    }
+                    else
+                    {
+                        exist = false;
+                        return static_cast<ValueType>(0);
+                    }
+                }
+                else
+                {
+                    if (buffer->get(key, ret_val))
+                    {
+                        exist = true;
+                        return ret_val;
+                    }
+                    else
+                    {
+                        exist = false;
+                        return static_cast<ValueType>(0);
+                    }
+                }
+            }
+            // if the fast pointer is valid
+            else
+            {
+
+                if (buffer->get(key, ret_val))
+                {
+                    exist = true;
+                    return ret_val;
+                }
+                else
+                {
+                    exist = false;
+                    return static_cast<ValueType>(0);
+                }
+            }
+        }
+
+        bool updateInExpand(Node *expandNode, const int &node_pos, const KeyType &key, const ValueType &value)
+        {
+        restart:
+            bool needRestart = false;
+            int expand_pos = expected_position(expandNode, key);
+            auto v = expandNode->slotLock(expand_pos).readLockOrRestart(needRestart);
+            if (needRestart)
+            {
+                // the node has been retrained, route again
+                if (expandNode->slotLock(expand_pos).isObsolete())
+                    return applyUpdate(key, value);
+                goto restart;
+            }
+
+            if (BITMAP_GET(expandNode->noneBitmap, expand_pos))
+            {
+                if (USE_LOCAL_SEARCH && updateWindow(expandNode, expand_pos, key, value, needRestart))
+                    return true;
+                if (needRestart)
+                    goto restart;
+                if (USE_DYNAMIC_RETRAIN && expandNode->expand)
+                {
+                    return updateInExpand(expandNode->expandNode, node_pos, key, value);
+                }
+                expandNode->slotLock(expand_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                if (needRestart)
+                    goto restart;
+                bool ok = buffer->update(key, value);
+                expandNode->slotLock(expand_pos).writeUnlock();
+                return ok;
+            }
+            else
+            {
+                // slot is occupied
+                if (expandNode->slotKey(expand_pos) == key)
+                {
+                    expandNode->slotLock(expand_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+                    expandNode->slotValue(expand_pos) = value;
+                    expandNode->slotLock(expand_pos).writeUnlock();
+                    return true;
+                }
+                else
+                {
+                    if (USE_LOCAL_SEARCH && updateWindow(expandNode, expand_pos, key, value, needRestart))
+                        return true;
+                    if (needRestart)
+                        goto restart;
+                    if (USE_DYNAMIC_RETRAIN && expandNode->expand)
+                    {
+                        return updateInExpand(expandNode->expandNode, node_pos, key, value);
+                    }
+                    // hold the slot so that a retrain doesn't move the key out of the buffer meanwhile
+                    expandNode->slotLock(expand_pos).upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart)
+                        goto restart;
+                    bool ok = buffer->update(key, value);
+                    expandNode->slotLock(expand_pos).writeUnlock();
+                    return ok;
+                }
+            }
+        }
+
+        /**
+         * @brief Destroy a node and reclaim memory.
+         * @param node The node to be destroyed.
+         */
+        void destroyNode(Node *node)
+        {
+            if (node == nullptr)
+                return;
+
+            delete_slots(node);
+            const int bitmap_size = BITMAP_SIZE(node->numItems);
+            delete_bitmap(node->noneBitmap, bitmap_size);
+        }
+
+        /**
+         * @brief Build an empty node.
+         * @return The newly created node.
+         */
+        Node *build_tree_none()
+        {
+            Node *node = new_nodes(1);
+            node->numInserts = node->numInsertToData = 0;
+            node->numItems = 1;
+            node->model.a = node->model.b = 0;
+            return node;
+        }
+
+        /**
+         * @brief Bulk load data to build the index. The keys are split into one part per thread: the parts are
+         *        segmented in parallel and stitched into the segments of a sequential run, then the nodes are built
+         *        in parallel and each thread puts the conflicts of its nodes into the buffer.
+         * @param kv Array of key-value pairs
+         * @param num_keys Number of data points
+         * @param thread_num Number of threads, 0 for one per hardware thread
+         */
+        void bulkLoad(const payload *kv, const int &num_keys, int thread_num = BULK_LOAD_THREAD_NUM)
+        {
+            if (num_keys == 0 || num_keys == 1)
+            {
+                return;
+            }
+            if (thread_num <= 0)
+            {
+                thread_num = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            }
+            thread_num = std::max(1, std::min(thread_num, num_keys / BULK_LOAD_MIN_PART));
+
+            // keys array has one spare entry, segmentPartition() reads one key past the segment
+            KeyType *keys = new KeyType[num_keys + 1];
+            ValueType *values = new ValueType[num_keys];
+            std::vector<int> bounds(thread_num + 1);
+            for (int t = 0; t <= thread_num; t++)
+            {
+                bounds[t] = static_cast<int>(static_cast<long long>(num_keys) * t / thread_num);
+            }
+            runParts(thread_num, [&](int t)
+                     {
+                         for (int i = bounds[t]; i < bounds[t + 1]; i++)
+                         {
+                             // check array is mono
+                             RT_ASSERT(i == 0 || kv[i].first > kv[i - 1].first);
+                             keys[i] = kv[i].first;
+                             values[i] = kv[i].second;
+                         } });
+            keys[num_keys] = keys[num_keys - 1];
+
+            gplEpsilon = num_keys / 1000;
+            // make segment partition
+            std::vector<std::vector<Segment>> part_segments(thread_num);
+            runParts(thread_num, [&](int t)
+                     {
+                         int used_index = bounds[t];
+                         while (used_index < bounds[t + 1])
+                         {
+                             Segment segment;
+                             segmentPartition(keys + used_index, bounds[t + 1] - used_index, segment, gplEpsilon);
+                             part_segments[t].push_back(segment);
+                             used_index += segment.numItems;
+                         } });
+            std::vector<Segment> segments = stitchSegments(keys, num_keys, bounds, part_segments);
+
+            // nodes are built by the thread of the part their first key is in
+            std::vector<int> offsets(segments.size() + 1, 0);
+            for (size_t i = 0; i < segments.size(); i++)
+            {
+                offsets[i + 1] = offsets[i] + segments[i].numItems;
+            }
+            std::vector<Node *> nodes(segments.size());
+            std::vector<KeyType> node_keys(segments.size());
+            std::vector<std::vector<payload>> part_conflicts(thread_num);
+            runParts(thread_num, [&](int t)
+                     {
+                         const size_t first = std::lower_bound(offsets.begin(), offsets.end() - 1, bounds[t]) - offsets.begin();
+                         const size_t last = std::lower_bound(offsets.begin(), offsets.end() - 1, bounds[t + 1]) - offsets.begin();
+                         std::vector<int> conflicts;
+                         std::vector<payload> &buffered = part_conflicts[t];
+                         for (size_t i = first; i < last; i++)
+                         {
+                             conflicts.clear();
+                             nodes[i] = bulkLoadNode(keys + offsets[i], values + offsets[i], segments[i], &conflicts);
+                             node_keys[i] = segments[i].firstKey;
+                             for (int index : conflicts)
+                             {
+                                 buffered.push_back({keys[offsets[i] + index], values[offsets[i] + index]});
+                             }
+                         } });
+            // the conflicts of the parts in part order are sorted, the buffer is built from them bottom-up
+            std::vector<payload> buffered;
+            for (auto &conflicts : part_conflicts)
+            {
+                buffered.insert(buffered.end(), conflicts.begin(), conflicts.end());
+                std::vector<payload>().swap(conflicts);
+            }
+            buffer->bulkBuildSorted(buffered.data(), buffered.size());
+            if (USE_STATISTIC)
+            {
+                buffer_num += buffered.size();
+            }
+            directory.build(node_keys.data(), nodes.data(), nodes.size());
+            if (USE_FAST_POINTER)
+                buildFastPointer();
+
+            delete[] keys;
+            delete[] values;
+        }
+
+        // run fn(t) for t in [0, thread_num), on threads of their own if there is more than one
+        template <typename Function>
+        static void runParts(const int thread_num, Function fn)
+        {
+            if (thread_num == 1)
+            {
+                fn(0);
+                return;
+            }
+            std::vector<std::thread> threads;
+            for (int t = 0; t < thread_num; t++)
+            {
+                threads.emplace_back(fn, t);
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        /**
+         * @brief Join the segments of the parts of the keys into the segments of a sequential run.
+         *        The last segment of a part may be cut short at the part end, so the run goes on from its first key
+         *        until a segment ends on a segment boundary of the next part; from there the segments of the part
+         *        are the same as those of the run.
+         * @param keys Keys, with a spare entry
+         * @param num_keys Number of keys
+         * @param bounds First key of each part, and num_keys
+         * @param part_segments Segments of each part
+         * @return Segments of all keys
+         */
+        std::vector<Segment> stitchSegments(KeyType *keys, const int num_keys, const std::vector<int> &bounds,
+                                            const std::vector<std::vector<Segment>> &part_segments)
+        {
+            std::vector<Segment> segments;
+            const int part_num = static_cast<int>(part_segments.size());
+            int used_index = 0;
+            for (int t = 0; t < part_num; t++)
+            {
+                const std::vector<Segment> &part = part_segments[t];
+                size_t next = 0;
+                int boundary = bounds[t];
+                while (used_index < bounds[t + 1])
+                {
+                    while (boundary < used_index && next < part.size())
+                    {
+                        boundary += part[next++].numItems;
+                    }
+                    if (boundary == used_index)
+                    {
+                        break;
+                    }
+                    Segment segment;
+                    segmentPartition(keys + used_index, num_keys - used_index, segment, gplEpsilon);
+                    segments.push_back(segment);
+                    used_index += segment.numItems;
+                }
+                if (used_index >= bounds[t + 1])
+                {
+                    continue;
+                }
+                const size_t end = t + 1 < part_num ? part.size() - 1 : part.size();
+                for (; next < end; next++)
+                {
+                    segments.push_back(part[next]);
+                    used_index += part[next].numItems;
+                }
+            }
+            return segments;
+        }
+
+        // bulk loading a node, each node corresponds to a segment
+        // keys without a slot go to the buffer, or to conflicts (indexes into keys) if it is given
+        Node *bulkLoadNode(KeyType *keys, ValueType *values, const Segment &segment, std::vector<int> *conflicts = nullptr,
+                           const double gaps = ARR_GAPS)
+        {
+            Node *node = allocNode();
+
+            const int size = segment.numItems;
+
+            node->numInserts = node->numInsertToData = 0;
+
+            // init a and b
+            node->model.a = ((segment.upperSlope + segment.lowerSlope) / 2) * (1.0 + gaps);
+            //            node->model.a = segment.upperSlope * (1.0 + ARR_GAPS);
+            node->model.b = 0.0 - node->model.a * segment.firstKey;
+            RT_ASSERT(isfinite(node->model.a));
+            RT_ASSERT(isfinite(node->model.b));
+
+            node->numItems = size * (1.0 + gaps);
+            new_slots(node, node->numItems);
+            const int bitmap_size = BITMAP_SIZE(node->numItems);
+            node->noneBitmap = new_bitmap(bitmap_size);
+            memset(node->noneBitmap, 0xff, sizeof(bitmap_t) * bitmap_size);
+
+            node->fastPointerIndex = 0;
+
+            for (int index = 0; index < size; index++)
+            {
+                int predict_pos = expected_position(node, keys[index]);
+                // slot is empty
+                if (BITMAP_GET(node->noneBitmap, predict_pos))
+                {
+                    BITMAP_CLEAR(node->noneBitmap, predict_pos);
+                    node->slotKey(predict_pos) = keys[index];
+                    node->slotValue(predict_pos) = values[index];
+                    node->numInsertToData++;
+                    #ifdef DEBUG
+                    if(keys[index] == 678844549){
+                        std::cout << "bulkload to node" << keys[index] << std::endl;
+                    }
+                    #endif
+                }
+                else if (conflicts != nullptr)
+                {
+                    conflicts->push_back(index);
+                }
+                else
+                {
+                    //                     buffer[keys[index]] = values[index];
+                    buffer->put(keys[index], values[index]);
+                    if (USE_STATISTIC)
+                    {
+                        buffer_num++;
+                    }
+                    #ifdef DEBUG
+                    if(keys[index] == 678844549){
+                        std::cout << "bulkload to buffer" << keys[index] << std::endl;
+                    }
+                    #endif
+                }
+                node->numInserts++;
+            }
+            return node;
+        }
+
+        void buildFastPointer()
+        {
+            int ret;
+            DirectoryVersion *version = directory.current();
+            const int node_num = version->getSize();
+            for (int i = 0; i < node_num - 1; i++)
+            {
+                buffer->build_fast_pointer(version->keys[i], version->keys[i + 1], ret);
+                version->node(i)->fastPointerIndex = ret;
+                //                flag < ret.second ? (flag = ret.second) : 0 ;
+            }
+            version->node(node_num - 1)->fastPointerIndex = 0;
+        }
+
+        // a node in a snapshot, followed by its bitmap, slot keys and slot values
+        struct SnapshotNode
+        {
+            int numItems;
+            int numInserts;
+            int numInsertToData;
+            int reserved;
+            double a;
+            double b;
+        };
+
+        void saveNode(SnapshotWriter &writer, Node *node)
+        {
+            const SnapshotNode record = {node->numItems, node->numInserts, node->numInsertToData, 0,
+                                         node->model.a, node->model.b};
+            writer.write(record);
+            writer.writeBytes(node->noneBitmap, sizeof(bitmap_t) * BITMAP_SIZE(node->numItems));
+#if USE_SOA_LAYOUT
+            writer.writeBytes(node->keys, sizeof(KeyType) * node->numItems);
+            writer.writeBytes(node->values, sizeof(ValueType) * node->numItems);
+#else
+            // the file has the slot keys and values in arrays of their own in both layouts
+            KeyType keys[SNAPSHOT_STAGE_SLOTS];
+            ValueType values[SNAPSHOT_STAGE_SLOTS];
+            for (int begin = 0; begin < node->numItems; begin += SNAPSHOT_STAGE_SLOTS)
+            {
+                const int n = std::min(node->numItems - begin, SNAPSHOT_STAGE_SLOTS);
+                for (int i = 0; i < n; i++)
+                    keys[i] = node->slotKey(begin + i);
+                writer.writeBytes(keys, sizeof(KeyType) * n);
+            }
+            for (int begin = 0; begin < node->numItems; begin += SNAPSHOT_STAGE_SLOTS)
+            {
+                const int n = std::min(node->numItems - begin, SNAPSHOT_STAGE_SLOTS);
+                for (int i = 0; i < n; i++)
+                    values[i] = node->slotValue(begin + i);
+                writer.writeBytes(values, sizeof(ValueType) * n);
+            }
+#endif
+        }
+
+        // nullptr if the slots of the node can't be in the rest of the file
+        Node *loadNode(SnapshotReader &reader)
+        {
+            SnapshotNode record;
+            if (!reader.read(record) || record.numItems <= 0 ||
+                !reader.fits(record.numItems, sizeof(KeyType) + sizeof(ValueType)))
+                return nullptr;
+
+            Node *node = allocNode();
+            node->numItems = record.numItems;
+            node->numInserts = record.numInserts;
+            node->numInsertToData = record.numInsertToData;
+            node->model.a = record.a;
+            node->model.b = record.b;
+            node->fastPointerIndex = 0;
+            node->expandNode = nullptr;
+            node->expand = false;
+            const int bitmap_size = BITMAP_SIZE(node->numItems);
+            node->noneBitmap = new_bitmap(bitmap_size);
+            reader.readBytes(node->noneBitmap, sizeof(bitmap_t) * bitmap_size);
+#if USE_SOA_LAYOUT
+            node->keys = new_aligned_array<KeyType>(node->numItems);
+            node->values = new_aligned_array<ValueType>(node->numItems);
+            node->locks = new_aligned_array<SlotLock>(SOA_LOCK_NUM(node->numItems));
+            memset(node->locks, 0, sizeof(SlotLock) * SOA_LOCK_NUM(node->numItems));
+            reader.readBytes(node->keys, sizeof(KeyType) * node->numItems);
+            reader.readBytes(node->values, sizeof(ValueType) * node->numItems);
+#else
+            // every slot is written below, the locks with the keys
+            node->items = itemAllocator.allocate(node->numItems);
+            KeyType keys[SNAPSHOT_STAGE_SLOTS];
+            ValueType values[SNAPSHOT_STAGE_SLOTS];
+            for (int begin = 0; begin < node->numItems; begin += SNAPSHOT_STAGE_SLOTS)
+            {
+                const int n = std::min(node->numItems - begin, SNAPSHOT_STAGE_SLOTS);
+                reader.readBytes(keys, sizeof(KeyType) * n);
+                for (int i = 0; i < n; i++)
+                {
+                    node->items[begin + i].typeVersionLockObsolete = 0;
+                    node->slotKey(begin + i) = keys[i];
+                }
+            }
+            for (int begin = 0; begin < node->numItems; begin += SNAPSHOT_STAGE_SLOTS)
+            {
+                const int n = std::min(node->numItems - begin, SNAPSHOT_STAGE_SLOTS);
+                reader.readBytes(values, sizeof(ValueType) * n);
+                for (int i = 0; i < n; i++)
+                    node->slotValue(begin + i) = values[i];
+            }
+#endif
+            return node;
+        }
+
+        /**
+         * @brief Write the index to a snapshot file: the first keys of the nodes, the model, bitmap and slots of
+         *        every node and of its expand nodes, and the records of the buffer, followed by a CRC-32C of the
+         *        whole file. Call it while no writes run; queued retraining tasks are waited for.
+         * @param path File, replaced once the snapshot is complete
+         * @param log_position Sequence number of the first write-ahead log record not in the index
+         * @return False if the file could not be written.
+         */
+        bool saveSnapshot(const char *path, uint64_t log_position = 0)
+        {
+            static_assert(std::is_trivially_copyable<KeyType>::value && std::is_trivially_copyable<ValueType>::value,
+                          "snapshots copy keys and values as bytes");
+            waitForRetrain();
+            EpochGuard guard;
+            SnapshotWriter writer(path);
+            SnapshotHeader header;
+            memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+            header.version = SNAPSHOT_FORMAT_VERSION;
+            header.keySize = sizeof(KeyType);
+            header.valueSize = sizeof(ValueType);
+            header.reserved = 0;
+            header.logPosition = log_position;
+            writer.write(header);
+
+            DirectoryVersion *version = directory.current();
+            const int node_num = version->getSize();
+            writer.write(node_num);
+            writer.write(gplEpsilon);
+            writer.write(buffer_num);
+            writer.writeBytes(version->keys, sizeof(KeyType) * node_num);
+            for (int i = 0; i < node_num; i++)
+            {
+                // a node and the expand nodes its inserts go to
+                int chain_length = 0;
+                for (Node *cur = version->node(i); cur != nullptr; cur = cur->expand ? cur->expandNode : nullptr)
+                    chain_length++;
+                writer.write(chain_length);
+                for (Node *cur = version->node(i); cur != nullptr; cur = cur->expand ? cur->expandNode : nullptr)
+                    saveNode(writer, cur);
+            }
+
+            std::vector<payload> records;
+            buffer->lookupRange(std::numeric_limits<KeyType>::min(), std::numeric_limits<KeyType>::max(), records);
+            const long long record_num = records.size();
+            writer.write(record_num);
+            writer.writeBytes(records.data(), sizeof(payload) * records.size());
+            return writer.finish();
+        }
+
+        /**
+         * @brief Load a snapshot written by saveSnapshot() into an empty index, like bulkLoad(). The slots are read
+         *        into the nodes as they were saved and the buffer is built bottom-up from its records, so loading
+         *        takes large sequential reads and no inserts. Fast pointers are built again.
+         * @param path File
+         * @param log_position Set to the sequence number of the first write-ahead log record not in the snapshot
+         * @return False if the index is not empty, or the file is missing, corrupt, or of another format or key
+         *         and value types; the index is left as it was then.
+         */
+        bool loadSnapshot(const char *path, uint64_t *log_position = nullptr)
+        {
+            if (directory.size() != 0)
+                return false;
+            SnapshotReader reader(path);
+            SnapshotHeader header;
+            if (!reader.read(header) || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+                header.version != SNAPSHOT_FORMAT_VERSION || header.keySize != sizeof(KeyType) ||
+                header.valueSize != sizeof(ValueType))
+                return false;
+
+            int node_num = 0, epsilon = 0;
+            long long buffered_num = 0;
+            if (!reader.read(node_num) || !reader.read(epsilon) || !reader.read(buffered_num) ||
+                !reader.fits(node_num, sizeof(KeyType)))
+                return false;
+            std::vector<KeyType> node_keys(node_num);
+            std::vector<Node *> nodes(node_num, nullptr);
+            std::vector<Node *> loaded; // all nodes read, freed if the file turns out corrupt
+            bool ok = reader.readBytes(node_keys.data(), sizeof(KeyType) * node_num);
+            for (int i = 0; i < node_num && ok; i++)
+            {
+                int chain_length = 0;
+                ok = reader.read(chain_length) && chain_length > 0;
+                Node *prev = nullptr;
+                for (int j = 0; j < chain_length && ok; j++)
+                {
+                    Node *node = loadNode(reader);
+                    ok = node != nullptr;
+                    if (!ok)
+                        break;
+                    loaded.push_back(node);
+                    if (prev == nullptr)
+                        nodes[i] = node;
+                    else
+                    {
+                        prev->expandNode = node;
+                        prev->expand = true;
+                    }
+                    prev = node;
+                }
+            }
+
+            long long record_num = 0;
+            ok = ok && reader.read(record_num) && reader.fits(record_num, sizeof(payload));
+            std::vector<payload> records(ok ? record_num : 0);
+            ok = ok && reader.readBytes(records.data(), sizeof(payload) * records.size()) && reader.finish();
+            if (!ok)
+            {
+                for (Node *node : loaded)
+                    freeNode(node);
+                return false;
+            }
+
+            gplEpsilon = epsilon;
+            buffer_num = buffered_num;
+            if (log_position != nullptr)
+                *log_position = header.logPosition;
+            buffer->bulkBuildSorted(records.data(), records.size());
+            if (node_num == 0)
+                return true;
+            directory.build(node_keys.data(), nodes.data(), node_num);
+            if (USE_FAST_POINTER)
+            {
+                buildFastPointer();
+                for (Node *node : nodes)
+                {
+                    for (Node *cur = node->expand ? node->expandNode : nullptr; cur != nullptr;
+                         cur = cur->expand ? cur->expandNode : nullptr)
+                        cur->fastPointerIndex = node->fastPointerIndex;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Save a snapshot holding all logged writes, then drop them from the write-ahead log.
+         *        Call it while no writes run. A crash in between leaves records the snapshot already
+         *        holds, which recover() skips.
+         * @param path Snapshot file
+         * @return False if the snapshot could not be written or the log could not be reset.
+         */
+        bool checkpoint(const char *path)
+        {
+            const uint64_t position = wal == nullptr ? 0 : wal->sequence();
+            if (!saveSnapshot(path, position))
+                return false;
+            return wal == nullptr || wal->reset(position);
+        }
+
+        /**
+         * @brief Load a snapshot into an empty index, replay the write-ahead log records it does not hold,
+         *        and log the following writes to the same log.
+         * @param path Snapshot file
+         * @param log Write-ahead log, opened on the log file of the index
+         * @return Number of records replayed, -1 if the snapshot could not be loaded or the log is not usable.
+         */
+        long long recover(const char *path, WriteAheadLog<KeyType, ValueType> *log)
+        {
+            uint64_t position = 0;
+            if (!log->ok() || !loadSnapshot(path, &position))
+                return -1;
+            const long long replayed = log->replay(position, [&](const typename WriteAheadLog<KeyType, ValueType>::Record &record)
+                                                   {
+                                                       if (record.op == WalOp::Insert)
+                                                           applyInsert(record.key, record.value);
+                                                       else if (record.op == WalOp::Update)
+                                                           applyUpdate(record.key, record.value);
+                                                       else if (record.op == WalOp::Remove)
+                                                           applyRemove(record.key); });
+            // a log file created anew ends before the snapshot, its records are numbered on from the snapshot
+            if (log->sequence() < position && !log->reset(position))
+                return -1;
+            wal = log;
+            return replayed;
+        }
+
+        /**
+         * @brief Wait until the queued retraining tasks have finished, e.g. before measuring memory.
+         */
+        void waitForRetrain()
+        {
+            retrainer.drain();
+        }
+
+        /**
+         * @brief Merge the buffered keys of a node back into GPL nodes: the node is refit over its slots
+         *        and its range of the buffer, possibly as several nodes, with COMPACTION_GAPS.
+         *        Runs online, e.g. on a maintenance thread.
+         * @param node_pos Position of the node in the directory
+         * @param stats Counters updated if the node is rebuilt
+         * @return False if the node is left as it is: few of its keys are buffered, it is the last node,
+         *         or it is being retrained.
+         */
+        bool compactNode(const int node_pos, CompactionStats &stats)
+        {
+            EpochGuard guard;
+            DirectoryVersion *version = directory.current();
+            if (node_pos < 0 || node_pos >= version->getSize())
+                return false;
+            Node *node = version->node(node_pos);
+            // the expand lock keeps expansions, evictions and batch inserts off the node
+            if (!node->expandLock.try_lock())
+                return false;
+            if (rebuildNode(node, node_pos, gplEpsilon / COMPACTION_ERROR_DIV, COMPACTION_GAPS, &stats))
+                return true;
+            node->expandLock.unlock();
+            return false;
+        }
+
+        /**
+         * @brief Run compactNode() over all nodes.
+         * @return Counters of the rebuilt nodes.
+         */
+        CompactionStats compact()
+        {
+            CompactionStats stats = {0, 0, 0, 0};
+            int node_pos = 0;
+            while (true)
+            {
+                EpochGuard guard;
+                DirectoryVersion *version = directory.current();
+                if (node_pos >= version->getSize() - 1)
+                    break;
+                const KeyType next_key = version->keys[node_pos + 1];
+                compactNode(node_pos, stats);
+                // the node may have been split, go on from the node after its key range
+                version = directory.current();
+                node_pos = version->route(next_key, version->getSize());
+            }
+            return stats;
+        }
+
+        /**
+         * @brief Move the fast pointers of the nodes to the heat of their buffer lookups sampled since the last call:
+         *        hot nodes get a deeper fast pointer per sub-range, nodes without sampled lookups fall back to the root,
+         *        and the others keep the one of their key range. Runs online, and on its own every
+         *        FAST_POINTER_ADAPT_PERIOD sampled lookups if USE_ADAPTIVE_FAST_POINTER is set.
+         * @return Number of nodes given sub-range fast pointers.
+         */
+        int adaptFastPointers()
+        {
+            std::lock_guard<spin_lock> adapt_guard(adaptLock);
+            EpochGuard guard;
+            const int root_index = buffer->makeFastRoot();
+            int hot_nodes = 0;
+            DirectoryVersion *version = directory.current();
+            for (int i = 0; i < version->getSize() - 1; i++)
+            {
+                // lookups of an expanding node are counted on its expand nodes
+                std::vector<Node *> chain;
+                int reads = 0;
+                for (Node *cur = version->node(i); cur != nullptr; cur = cur->expand ? cur->expandNode : nullptr)
+                {
+                    chain.push_back(cur);
+                    reads += cur->bufferReads;
+                    cur->bufferReads = 0;
+                }
+
+                int fast_pointer_index = root_index;
+                FastRanges *ranges = nullptr;
+                if (reads > 0)
+                    buffer->build_fast_pointer(version->keys[i], version->keys[i + 1], fast_pointer_index);
+                if (reads >= FAST_POINTER_HOT_READS)
+                {
+                    ranges = buildFastRanges(version->keys[i], version->keys[i + 1] - 1);
+                    FastRanges *current = chain.front()->fastRanges.load(std::memory_order_acquire);
+                    if (ranges != nullptr && current != nullptr && *ranges == *current)
+                    {
+                        delete ranges;
+                        ranges = current;
+                    }
+                    else if (ranges != nullptr)
+                    {
+                        // lookups may still read replaced sub-ranges, they are freed with the index
+                        builtFastRanges.push_back(ranges);
+                    }
+                    hot_nodes += ranges != nullptr;
+                }
+                for (Node *cur : chain)
+                {
+                    cur->fastPointerIndex = fast_pointer_index;
+                    cur->fastRanges.store(ranges, std::memory_order_release);
+                }
+            }
+            sampledReads.store(0, std::memory_order_relaxed);
+            skippedDepth.store(0, std::memory_order_relaxed);
+            return hot_nodes;
+        }
+
+        /**
+         * @brief Average number of key bytes that the buffer lookups sampled since the last adaptation skipped
+         *        by starting from a fast pointer.
+         * @return Average skipped depth, 0 if no lookup has been sampled.
+         */
+        double averageSkippedDepth() const
+        {
+            const long long samples = sampledReads.load(std::memory_order_relaxed);
+            return samples == 0 ? 0.0 : static_cast<double>(skippedDepth.load(std::memory_order_relaxed)) / samples;
+        }
+
+        /**
+         * @brief Calculate the memory consumption of the index structure.
+         * @return Memory consumption size.
+         */
+        long long memoryConsumption() const
+        {
+            EpochGuard guard;
+            long long size = 0;
+
+            DirectoryVersion *version = directory.current();
+            for (int i = 0; i < version->getSize(); i++)
+            {
+                Node *node = version->node(i);
+                //                size += sizeof(Node);
+                //                size += sizeof(*(nodes[i]->noneBitmap));
+                size += sizeof(bitmap_t) * BITMAP_SIZE(node->numItems);
+                //                size += sizeof(KeyType);
+                //                for(int i = 0 ; i < nodes[i]->numItems ; i++){
+                //                    size += sizeof(Item);
+                //                }
+                size += slot_bytes(node->numItems);
+            }
+            size += buffer->memory_consumption();
+            size += directory.memoryConsumption();
+            return size;
+        }
+
+        /**
+         * @brief Print information about fast pointers.
+         */
+        void printFastPointer()
+        {
+            EpochGuard guard;
+            std::vector<uint64_t> res;
+            buffer->get_fast_pointer(res);
+            long double save_path_num = 0.0;
+            DirectoryVersion *version = directory.current();
+            for (int i = 0; i < version->getSize(); i++)
+            {
+                Node *node = version->node(i);
+                save_path_num += res[node->fastPointerIndex] * (node->numInserts - node->numInsertToData);
+            }
+            std::cout << "average reduced path length:" << save_path_num / buffer_num << std::endl;
+            std::cout << "fast buffer size:" << res.size() << std::endl;
+            if (USE_ADAPTIVE_FAST_POINTER)
+                std::cout << "average skipped depth of sampled lookups:" << averageSkippedDepth() << std::endl;
+        }
+
+    public:
+        NodeDirectory<KeyType, Node> directory; // store model nodes and node_keys to locate model index
+        RetrainService retrainer;               // runs expand node builds and evictions
+        int gplEpsilon;                         // error bound of the GPL segments, set by bulk loading
+        //        std::map<KeyType, ValueType> buffer;  //conflict data will be put into buffer
+        artInterface<KeyType, ValueType> *buffer;
+        WriteAheadLog<KeyType, ValueType> *wal; // logs the writes if set, see recover()
+
+        long long buffer_num;
+
+    private:
+        std::atomic<long long> sampledReads{0}; // buffer lookups sampled by sampleBufferRead()
+        std::atomic<long long> skippedDepth{0}; // key bytes they skipped in the buffer
+        std::atomic<bool> adaptQueued{false};
+        std::atomic<uint64_t> retiredNodes{0};  // nodes retired so far, see Iterator
+        spin_lock adaptLock;                    // one adaptFastPointers() at a time
+        std::vector<FastRanges *> builtFastRanges; // all sub-range fast pointers built
+    };
+
+}
+
+#endif // ALT_INDEX_ALT_INDEX_H
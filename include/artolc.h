@@ -1,207 +1,360 @@
-//
-// Created by yyx on 2023/3/27.
-//
-
-#ifndef ALT_INDEX_ARTOLC_H
-#define ALT_INDEX_ARTOLC_H
-
-#include "OptimizedART/Tree.h"
-#include "OptimizedART/Tree.cpp"
-#include <utility>
-
-namespace alt_index
-{
-
-    template <class key_type, class value_type>
-    class artInterface
-    {
-    public:
-        artInterface()
-        {
-            index = new ART_OLC::Tree(loadKey);
-            auto init_pair = new std::pair<key_type, value_type>(~0ull, 0);
-            loadKey(reinterpret_cast<uint64_t>(&init_pair), max_key);
-        }
-
-        ~artInterface()
-        {
-            delete index;
-        }
-
-        void bulkLoad(std::pair<key_type, value_type> *data, size_t nums)
-        {
-            for (size_t i = 0; i < nums; i++)
-            {
-                put(data[i].first, data[i].second);
-            }
-        }
-
-        bool put(key_type key, value_type value)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-
-            auto temp = new std::pair<key_type, value_type>(key, value);
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            index->insert(k, reinterpret_cast<TID>(temp), tid);
-            return true;
-        }
-
-        bool fastPut(key_type key, value_type value, int &fast_pointer_index)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-
-            auto temp = new std::pair<key_type, value_type>(key, value);
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            index->fast_insert(k, reinterpret_cast<TID>(temp), fast_pointer_index, tid);
-            return true;
-        }
-
-        bool get(key_type key, value_type &value)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-            bool ok = false;
-
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            auto value_ptr = reinterpret_cast<std::pair<key_type, value_type> *>(index->lookup(k, tid));
-            if (value_ptr)
-            {
-                value = value_ptr->second;
-                ok = true;
-            }
-
-            return ok;
-        }
-
-        bool fastGet(key_type key, value_type &value, int &fast_pointer_index)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-            bool ok = false;
-
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            auto value_ptr = reinterpret_cast<std::pair<key_type, value_type> *>(index->fast_lookup(k, fast_pointer_index, tid));
-            if (value_ptr)
-            {
-                value = value_ptr->second;
-                ok = true;
-            }
-
-            return ok;
-        }
-
-        bool update(key_type key, value_type value)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-
-            auto temp = new std::pair<key_type, value_type>(key, value);
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            return index->update(k, reinterpret_cast<TID>(temp), tid);
-        }
-
-        bool remove(key_type key)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-            bool ok = false;
-
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            index->remove(k, tid);
-            return ok;
-        }
-
-        bool fast_remove(key_type key, int &fast_pointer_index)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-            bool ok = false;
-
-            Key k;
-            key_type reserved = swap_endian(key);
-            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
-            index->fast_remove(k, fast_pointer_index, tid);
-            return ok;
-        }
-
-        size_t scan(key_type key_low_bound, key_type key_upper_bound, size_t key_num)
-        {
-            thread_local static auto t = index->getThreadInfo();
-            Key k_start;
-            k_start.setKeyLen(sizeof(key_low_bound));
-            reinterpret_cast<key_type *>(&k_start[0])[0] = swap_endian(key_low_bound);
-
-            Key k_end;
-            k_end.setKeyLen(sizeof(key_upper_bound));
-            reinterpret_cast<key_type *>(&k_end[0])[0] = swap_endian(key_upper_bound);
-
-            TID results[key_num];
-            size_t resultCount;
-            Key continueKey;
-            index->fast_lookupRange(k_start, k_end, continueKey, results, key_num, resultCount, t);
-            return resultCount;
-        }
-
-        void build_fast_pointer(key_type key1, key_type key2, int &ret)
-        {
-            thread_local static auto tid = index->getThreadInfo();
-
-            Key k1, k2;
-            key_type reserved1 = swap_endian(key1);
-            key_type reserved2 = swap_endian(key2);
-            k1.set(reinterpret_cast<char *>(&reserved1), sizeof(key1));
-            k2.set(reinterpret_cast<char *>(&reserved2), sizeof(key2));
-            index->build_fast_pointer(k1, k2, ret, tid);
-        }
-
-        void makeFastRoot()
-        {
-            index->makeFastRoot();
-        }
-
-        ART_OLC::N *get_root()
-        {
-            return index->root;
-        }
-
-        // init the key load function
-        static void loadKey(TID tid, Key &key)
-        {
-            std::pair<key_type, value_type> *value_ptr = reinterpret_cast<std::pair<key_type, value_type> *>(tid);
-            key_type reserved = swap_endian(value_ptr->first);
-            key.set(reinterpret_cast<char *>(&reserved), sizeof(value_ptr->first));
-        }
-
-        long long memory_consumption() const
-        {
-            return index->size() + index->memoryFastPointer();
-        }
-
-        void get_fast_pointer(std::vector<uint64_t>& res){
-            index->getFastPointer(res);
-        }
-
-    public:
-        Key max_key;          // upper bound of the key for scan
-        ART_OLC::Tree *index; // art pointer
-
-        inline static uint32_t swap_endian(uint32_t i)
-        {
-            return __builtin_bswap32(i);
-        }
-        inline static uint64_t swap_endian(uint64_t i)
-        {
-            return __builtin_bswap64(i);
-        }
-    };
-
-}
-
-#endif // ALT_INDEX_ARTOLC_H
+//
+// Created by yyx on 2023/3/27.
+//
+
+#ifndef ALT_INDEX_ARTOLC_H
+#define ALT_INDEX_ARTOLC_H
+
+#include "OptimizedART/Tree.h"
+#include "OptimizedART/Tree.cpp"
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define LOOKUP_RANGE_BATCH 256 // records fetched from the tree per range lookup call
+
+namespace alt_index
+{
+
+    template <class key_type, class value_type>
+    class artInterface
+    {
+        using record_type = std::pair<key_type, value_type>;
+
+        // values of a machine word are updated in place and read atomically, larger ones get a new record
+        using inplace_update = std::integral_constant<bool, std::is_trivially_copyable<value_type>::value &&
+                                                                (sizeof(value_type) == 1 || sizeof(value_type) == 2 ||
+                                                                 sizeof(value_type) == 4 || sizeof(value_type) == 8)>;
+
+    public:
+        artInterface()
+        {
+            index = new ART_OLC::Tree(loadKey, freeRecord);
+            auto init_pair = new std::pair<key_type, value_type>(~0ull, 0);
+            loadKey(reinterpret_cast<uint64_t>(&init_pair), max_key);
+        }
+
+        ~artInterface()
+        {
+            delete index;
+        }
+
+        void bulkLoad(std::pair<key_type, value_type> *data, size_t nums)
+        {
+            for (size_t i = 0; i < nums; i++)
+            {
+                put(data[i].first, data[i].second);
+            }
+        }
+
+        bool put(key_type key, value_type value)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            auto temp = newRecord(key, value);
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            index->insert(k, reinterpret_cast<TID>(temp), tid);
+            return true;
+        }
+
+        bool fastPut(key_type key, value_type value, int &fast_pointer_index)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            auto temp = newRecord(key, value);
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            index->fast_insert(k, reinterpret_cast<TID>(temp), fast_pointer_index, tid);
+            return true;
+        }
+
+        // put a batch of key-value pairs with one thread info and key encoding loop
+        bool bulkPut(const std::pair<key_type, value_type> *kv, size_t nums)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            Key k;
+            for (size_t i = 0; i < nums; i++)
+            {
+                auto temp = newRecord(kv[i].first, kv[i].second);
+                key_type reserved = swap_endian(kv[i].first);
+                k.set(reinterpret_cast<char *>(&reserved), sizeof(key_type));
+                index->insert(k, reinterpret_cast<TID>(temp), tid);
+            }
+            return true;
+        }
+
+        // build the tree from key-value pairs in ascending key order, must not run concurrently with writers
+        bool bulkBuildSorted(const std::pair<key_type, value_type> *kv, size_t nums)
+        {
+            std::vector<key_type> keys(nums);
+            std::vector<TID> tids(nums);
+            for (size_t i = 0; i < nums; i++)
+            {
+                keys[i] = swap_endian(kv[i].first);
+                tids[i] = reinterpret_cast<TID>(newRecord(kv[i].first, kv[i].second));
+            }
+            index->bulkBuildSorted(reinterpret_cast<const uint8_t *>(keys.data()), sizeof(key_type), tids.data(), nums);
+            return true;
+        }
+
+        bool bulkFastPut(const std::pair<key_type, value_type> *kv, size_t nums, int &fast_pointer_index)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            Key k;
+            for (size_t i = 0; i < nums; i++)
+            {
+                auto temp = newRecord(kv[i].first, kv[i].second);
+                key_type reserved = swap_endian(kv[i].first);
+                k.set(reinterpret_cast<char *>(&reserved), sizeof(key_type));
+                index->fast_insert(k, reinterpret_cast<TID>(temp), fast_pointer_index, tid);
+            }
+            return true;
+        }
+
+        bool get(key_type key, value_type &value)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+            bool ok = false;
+
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            // the record of a key removed meanwhile is not reused before the guard is left
+            ART::EpocheGuardReadonly guard(tid);
+            auto value_ptr = reinterpret_cast<record_type *>(index->lookup(k, tid));
+            if (value_ptr)
+            {
+                value = loadValue(value_ptr, inplace_update());
+                ok = true;
+            }
+
+            return ok;
+        }
+
+        bool fastGet(key_type key, value_type &value, int &fast_pointer_index)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+            bool ok = false;
+
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            ART::EpocheGuardReadonly guard(tid);
+            auto value_ptr = reinterpret_cast<record_type *>(index->fast_lookup(k, fast_pointer_index, tid));
+            if (value_ptr)
+            {
+                value = loadValue(value_ptr, inplace_update());
+                ok = true;
+            }
+
+            return ok;
+        }
+
+        bool update(key_type key, value_type value)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            return update(k, key, value, tid, inplace_update());
+        }
+
+        bool remove(key_type key)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+            bool ok = false;
+
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            index->remove(k, tid);
+            return ok;
+        }
+
+        bool fast_remove(key_type key, int &fast_pointer_index)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+            bool ok = false;
+
+            Key k;
+            key_type reserved = swap_endian(key);
+            k.set(reinterpret_cast<char *>(&reserved), sizeof(key));
+            index->fast_remove(k, fast_pointer_index, tid);
+            return ok;
+        }
+
+        // collect the records with keys in [key_low_bound, key_upper_bound] in key order
+        void lookupRange(key_type key_low_bound, key_type key_upper_bound, std::vector<std::pair<key_type, value_type>> &res)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            Key k_start, k_end, continueKey;
+            key_type reserved_low = swap_endian(key_low_bound);
+            key_type reserved_high = swap_endian(key_upper_bound);
+            k_start.set(reinterpret_cast<char *>(&reserved_low), sizeof(key_low_bound));
+            k_end.set(reinterpret_cast<char *>(&reserved_high), sizeof(key_upper_bound));
+
+            TID results[LOOKUP_RANGE_BATCH];
+            size_t resultCount;
+            ART::EpocheGuardReadonly guard(tid);
+            while (true)
+            {
+                bool more = index->lookupRange(k_start, k_end, continueKey, results, LOOKUP_RANGE_BATCH, resultCount, tid);
+                for (size_t i = 0; i < resultCount; i++)
+                {
+                    auto record = reinterpret_cast<record_type *>(results[i]);
+                    if (record->first >= key_low_bound && record->first <= key_upper_bound)
+                        res.push_back({record->first, loadValue(record, inplace_update())});
+                }
+                if (!more)
+                    break;
+                // continue from the first record not returned
+                k_start.set(reinterpret_cast<const char *>(&continueKey[0]), continueKey.getKeyLen());
+            }
+        }
+
+        // copy the first records with keys in [key_low_bound, key_upper_bound] in key order, at most max_num of them
+        size_t lookupRange(key_type key_low_bound, key_type key_upper_bound, std::pair<key_type, value_type> *res, size_t max_num)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            Key k_start, k_end, continueKey;
+            key_type reserved_low = swap_endian(key_low_bound);
+            key_type reserved_high = swap_endian(key_upper_bound);
+            k_start.set(reinterpret_cast<char *>(&reserved_low), sizeof(key_low_bound));
+            k_end.set(reinterpret_cast<char *>(&reserved_high), sizeof(key_upper_bound));
+
+            TID results[LOOKUP_RANGE_BATCH];
+            size_t resultCount, found = 0;
+            ART::EpocheGuardReadonly guard(tid);
+            while (found < max_num)
+            {
+                bool more = index->lookupRange(k_start, k_end, continueKey, results,
+                                               std::min<size_t>(LOOKUP_RANGE_BATCH, max_num - found), resultCount, tid);
+                for (size_t i = 0; i < resultCount; i++)
+                {
+                    auto record = reinterpret_cast<record_type *>(results[i]);
+                    if (record->first >= key_low_bound && record->first <= key_upper_bound)
+                        res[found++] = {record->first, loadValue(record, inplace_update())};
+                }
+                if (!more)
+                    break;
+                k_start.set(reinterpret_cast<const char *>(&continueKey[0]), continueKey.getKeyLen());
+            }
+            return found;
+        }
+
+        void build_fast_pointer(key_type key1, key_type key2, int &ret)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+
+            Key k1, k2;
+            key_type reserved1 = swap_endian(key1);
+            key_type reserved2 = swap_endian(key2);
+            k1.set(reinterpret_cast<char *>(&reserved1), sizeof(key1));
+            k2.set(reinterpret_cast<char *>(&reserved2), sizeof(key2));
+            index->build_fast_pointer(k1, k2, ret, tid);
+        }
+
+        int makeFastRoot()
+        {
+            return index->makeFastRoot();
+        }
+
+        // key bytes a fast lookup from the fast pointer skips
+        uint32_t fast_pointer_level(int fast_pointer_index)
+        {
+            thread_local static auto tid = index->getThreadInfo();
+            return index->fastPointerLevel(fast_pointer_index, tid);
+        }
+
+        ART_OLC::N *get_root()
+        {
+            return index->root;
+        }
+
+        // init the key load function
+        static void loadKey(TID tid, Key &key)
+        {
+            record_type *value_ptr = reinterpret_cast<record_type *>(tid);
+            key_type reserved = swap_endian(value_ptr->first);
+            key.set(reinterpret_cast<char *>(&reserved), sizeof(value_ptr->first));
+        }
+
+        long long memory_consumption() const
+        {
+            return index->size() + index->memoryFastPointer() + index->leafCount() * sizeof(record_type);
+        }
+
+        void get_fast_pointer(std::vector<uint64_t>& res){
+            index->getFastPointer(res);
+        }
+
+    public:
+        Key max_key;          // upper bound of the key for scan
+        ART_OLC::Tree *index; // art pointer
+
+        inline static uint32_t swap_endian(uint32_t i)
+        {
+            return __builtin_bswap32(i);
+        }
+        inline static uint64_t swap_endian(uint64_t i)
+        {
+            return __builtin_bswap64(i);
+        }
+
+        // allocation statistics of the records, shared by the trees with the same record type
+        static ART::SlabStats recordStats()
+        {
+            return ART::Slab<record_type>::stats();
+        }
+
+    private:
+        static record_type *newRecord(key_type key, value_type value)
+        {
+            return new (ART::Slab<record_type>::allocate()) record_type(key, value);
+        }
+
+        static void freeRecord(void *record)
+        {
+            ART::Slab<record_type>::free(record);
+        }
+
+        bool update(const Key &k, key_type key, value_type value, ART::ThreadInfo &tid, std::true_type)
+        {
+            ART::EpocheGuardReadonly guard(tid);
+            auto value_ptr = reinterpret_cast<record_type *>(index->lookup(k, tid));
+            if (value_ptr == nullptr)
+                return false;
+            // a record removed meanwhile takes a value nobody reads
+            __atomic_store(&value_ptr->second, &value, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        bool update(const Key &k, key_type key, value_type value, ART::ThreadInfo &tid, std::false_type)
+        {
+            return index->update(k, reinterpret_cast<TID>(newRecord(key, value)), tid);
+        }
+
+        static value_type loadValue(const record_type *record, std::true_type)
+        {
+            value_type value;
+            __atomic_load(&record->second, &value, __ATOMIC_ACQUIRE);
+            return value;
+        }
+
+        static value_type loadValue(const record_type *record, std::false_type)
+        {
+            return record->second;
+        }
+    };
+
+}
+
+#endif // ALT_INDEX_ARTOLC_H
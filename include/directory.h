@@ -0,0 +1,265 @@
+#ifndef ALT_INDEX_DIRECTORY_H
+#define ALT_INDEX_DIRECTORY_H
+
+#include "router.h"
+#include "concurrency.h"
+#include "epoch.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#define DIRECTORY_INIT_CAPACITY 1024
+
+namespace alt_index
+{
+
+    /**
+     * @brief Versioned directory of the GPL nodes and their first keys (node_keys).
+     *        Readers load the current version and only touch entries below its published size,
+     *        so they never observe a reallocated buffer: appends write past the published size
+     *        of the current version, while growth and splits copy the directory into a new
+     *        version that is published atomically. Replaced versions are retired, they stay intact for
+     *        the readers holding an EpochGuard. Writers are serialized by a spin lock.
+     */
+    template <class KeyType, class NodeType>
+    class NodeDirectory
+    {
+    public:
+        struct Version
+        {
+            KeyType *keys;                                // first key of each node
+            std::atomic<NodeType *> *nodes;               // GPL nodes
+            int capacity;                                 // allocated entries
+            std::atomic<int> size;                        // published entries
+            std::shared_ptr<NodeRouter<KeyType>> router;  // router built over a prefix of keys
+
+            explicit Version(int capacity) : capacity(capacity), size(0)
+            {
+                keys = new KeyType[capacity];
+                nodes = new std::atomic<NodeType *>[capacity];
+            }
+
+            Version(const Version &) = delete;
+
+            ~Version()
+            {
+                delete[] keys;
+                delete[] nodes;
+            }
+
+            inline int getSize() const
+            {
+                return size.load(std::memory_order_acquire);
+            }
+
+            /**
+             * @brief Locate the node of a key.
+             * @return Node position; keys smaller than the first node key go to the first node.
+             */
+            inline int route(const KeyType &key, int num) const
+            {
+                int node_pos = router->route(keys, num, key);
+                return node_pos < 0 ? 0 : node_pos;
+            }
+
+            inline NodeType *node(int pos) const
+            {
+                return nodes[pos].load(std::memory_order_acquire);
+            }
+        };
+
+        explicit NodeDirectory(RouterType router_type = RouterType::BinarySearch) : router_type(router_type)
+        {
+            Version *version = new Version(DIRECTORY_INIT_CAPACITY);
+            version->router = std::make_shared<NodeRouter<KeyType>>(router_type);
+            current_version.store(version);
+        }
+
+        NodeDirectory(const NodeDirectory &) = delete;
+
+        ~NodeDirectory()
+        {
+            delete current_version.load();
+        }
+
+        inline Version *current() const
+        {
+            return current_version.load(std::memory_order_acquire);
+        }
+
+        inline int size() const
+        {
+            return current()->getSize();
+        }
+
+        inline RouterType routerType() const
+        {
+            return router_type;
+        }
+
+        /**
+         * @brief Replace the whole directory, used by bulk loading.
+         * @param keys Sorted first keys of the nodes
+         * @param nodes Nodes
+         * @param n Number of nodes
+         */
+        void build(const KeyType *keys, NodeType *const *nodes, int n)
+        {
+            lock.lock();
+            Version *version = new Version(std::max(n * 2, DIRECTORY_INIT_CAPACITY));
+            for (int i = 0; i < n; i++)
+            {
+                version->keys[i] = keys[i];
+                version->nodes[i].store(nodes[i], std::memory_order_relaxed);
+            }
+            version->size.store(n, std::memory_order_relaxed);
+            version->router = std::make_shared<NodeRouter<KeyType>>(router_type);
+            version->router->build(version->keys, n);
+            publish(version);
+            lock.unlock();
+        }
+
+        /**
+         * @brief Append a node after the last one.
+         * @param key First key of the node, greater than all node keys
+         * @param node Node
+         */
+        void append(const KeyType &key, NodeType *node)
+        {
+            lock.lock();
+            Version *version = current();
+            const int num = version->size.load(std::memory_order_relaxed);
+            if (num == version->capacity)
+            {
+                // grow into a new version, keys appended after the router build are searched in the tail
+                Version *grown = new Version(version->capacity * 2);
+                copyEntries(version, 0, num, grown, 0);
+                grown->size.store(num, std::memory_order_relaxed);
+                grown->router = version->router;
+                publish(grown);
+                version = grown;
+            }
+            version->keys[num] = key;
+            version->nodes[num].store(node, std::memory_order_relaxed);
+            version->size.store(num + 1, std::memory_order_release);
+            lock.unlock();
+        }
+
+        /**
+         * @brief Position of a node in the current version.
+         * @param node Node
+         * @param hint Position where node was seen
+         * @return Position, -1 if the node is not in the directory.
+         */
+        int position(NodeType *node, int hint) const
+        {
+            return find(current(), node, hint);
+        }
+
+        /**
+         * @brief Replace a node with several nodes, e.g. when a node is split.
+         * @param old_node Node to be replaced
+         * @param hint Position where old_node was seen
+         * @param keys Sorted first keys of the new nodes, keys[0] takes the place of the replaced key
+         * @param nodes New nodes
+         * @param n Number of new nodes
+         * @return True if old_node was found and replaced.
+         */
+        bool split(NodeType *old_node, int hint, const KeyType *keys, NodeType *const *nodes, int n)
+        {
+            lock.lock();
+            Version *version = current();
+            const int num = version->size.load(std::memory_order_relaxed);
+            const int pos = find(version, old_node, hint);
+            if (pos < 0)
+            {
+                lock.unlock();
+                return false;
+            }
+
+            Version *next = new Version(std::max(version->capacity, (num + n) * 2));
+            copyEntries(version, 0, pos, next, 0);
+            for (int i = 0; i < n; i++)
+            {
+                next->keys[pos + i] = keys[i];
+                next->nodes[pos + i].store(nodes[i], std::memory_order_relaxed);
+            }
+            copyEntries(version, pos + 1, num, next, pos + n);
+            next->size.store(num + n - 1, std::memory_order_relaxed);
+            next->router = std::make_shared<NodeRouter<KeyType>>(router_type);
+            next->router->build(next->keys, num + n - 1);
+            publish(next);
+            lock.unlock();
+            return true;
+        }
+
+        /**
+         * @brief Replace a node in place, e.g. by its expand node.
+         * @param old_node Node to be replaced
+         * @param new_node New node
+         * @param hint Position where old_node was seen
+         * @return True if old_node was found and replaced.
+         */
+        bool replace(NodeType *old_node, NodeType *new_node, int hint)
+        {
+            lock.lock();
+            Version *version = current();
+            const int pos = find(version, old_node, hint);
+            if (pos >= 0)
+            {
+                version->nodes[pos].store(new_node, std::memory_order_release);
+            }
+            lock.unlock();
+            return pos >= 0;
+        }
+
+        /**
+         * @brief Memory used by the current version, including its router.
+         */
+        long long memoryConsumption() const
+        {
+            Version *version = current();
+            return (sizeof(KeyType) + sizeof(NodeType *)) * static_cast<long long>(version->capacity) +
+                   version->router->memoryConsumption();
+        }
+
+    private:
+        static int find(Version *version, NodeType *node, int hint)
+        {
+            const int num = version->getSize();
+            if (hint >= 0 && hint < num && version->node(hint) == node)
+                return hint;
+            for (int i = 0; i < num; i++)
+            {
+                if (version->node(i) == node)
+                    return i;
+            }
+            return -1;
+        }
+
+        static void copyEntries(Version *from, int begin, int end, Version *to, int to_begin)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                to->keys[to_begin + i - begin] = from->keys[i];
+                to->nodes[to_begin + i - begin].store(from->node(i), std::memory_order_relaxed);
+            }
+        }
+
+        // publish a new version, the replaced one is freed once no reader can reach it
+        void publish(Version *version)
+        {
+            EpochGuard guard;
+            Version *old_version = current_version.load(std::memory_order_relaxed);
+            current_version.store(version, std::memory_order_release);
+            retire(old_version, [](void *retired)
+                   { delete static_cast<Version *>(retired); });
+        }
+
+        std::atomic<Version *> current_version;
+        RouterType router_type;
+        spin_lock lock;
+    };
+}
+
+#endif // ALT_INDEX_DIRECTORY_H
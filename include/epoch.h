@@ -0,0 +1,45 @@
+#ifndef ALT_INDEX_EPOCH_H
+#define ALT_INDEX_EPOCH_H
+
+#include <algorithm>
+#include <cassert>
+#include "OptimizedART/Epoche.h"
+
+namespace alt_index
+{
+
+    /**
+     * @brief Epoch based reclamation of GPL nodes and directory versions, on the epochs of the ART buffer.
+     *        Readers hold a guard while they use nodes or versions taken from the directory, and an object
+     *        replaced in the directory is retired and freed once every guard older than its retirement has been
+     *        released. Guards nest, so the buffer operations inside an index operation reuse its guard.
+     */
+    class EpochGuard
+    {
+    public:
+        EpochGuard()
+        {
+            ART::EpochBasedMemoryReclamationStrategy::getInstance()->enterCriticalSection();
+        }
+
+        ~EpochGuard()
+        {
+            ART::EpochBasedMemoryReclamationStrategy::getInstance()->leaveCriticialSection();
+        }
+
+        EpochGuard(const EpochGuard &) = delete;
+        EpochGuard &operator=(const EpochGuard &) = delete;
+    };
+
+    /**
+     * @brief Free an object once no guard can reach it anymore, called while holding a guard.
+     * @param object Object no longer reachable by new readers
+     * @param deleter Function that frees it
+     */
+    inline void retire(void *object, ART::Deleter deleter)
+    {
+        ART::EpochBasedMemoryReclamationStrategy::getInstance()->scheduleForDeletion(object, deleter);
+    }
+}
+
+#endif // ALT_INDEX_EPOCH_H
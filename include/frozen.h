@@ -0,0 +1,466 @@
+#ifndef ALT_INDEX_FROZEN_H
+#define ALT_INDEX_FROZEN_H
+
+#include "alt_index.h"
+#include "snapshot.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FROZEN_FORMAT_VERSION 1
+#define FROZEN_ALIGNMENT 64   // sections and slot arrays start on cache lines
+#define FROZEN_SPARSE_MAX 48  // most children of a buffer node that keeps a sorted byte array, more take 256 entries
+
+namespace alt_index
+{
+    static const char FROZEN_MAGIC[8] = {'A', 'L', 'T', 'F', 'R', 'O', 'Z', '\0'};
+
+    // first bytes of a frozen index file, the offsets are in bytes from its start
+    struct FrozenHeader
+    {
+        char magic[8];
+        uint32_t version;      // FROZEN_FORMAT_VERSION
+        uint32_t keySize;      // sizeof(KeyType)
+        uint32_t valueSize;    // sizeof(ValueType)
+        uint32_t flags;        // lookup behaviour of the index the file was built from, FROZEN_FLAG_*
+        uint32_t window;       // LOCAL_SEARCH_WINDOW it was built with
+        int32_t entryNum;      // directory entries
+        int32_t nodeNum;       // GPL nodes, with the expand nodes
+        uint32_t reserved;
+        uint64_t recordNum;    // buffered records
+        uint64_t bufferRoot;   // child word of the root of the buffer, 0 if it is empty
+        uint64_t nodeKeysOffset;
+        uint64_t headsOffset;  // first node of each entry
+        uint64_t nodesOffset;
+        uint64_t recordsOffset;
+        uint64_t bufferOffset;
+        uint64_t bufferWords;
+        uint64_t dataSize;     // bytes before the CRC-32C at the end of the file
+    };
+
+    enum FrozenFlags : uint32_t
+    {
+        FROZEN_FLAG_LOCAL_SEARCH = 1,
+        FROZEN_FLAG_DYNAMIC_RETRAIN = 2
+    };
+
+    /**
+     * @brief Read-only index served from a memory-mapped file. The file holds the node keys, a table of the GPL
+     *        nodes with their models, the bitmaps, keys and values of their slots, the sorted buffered records, and
+     *        the buffer flattened into a radix tree of 64-bit words whose children are offsets instead of pointers.
+     *        Opening maps the file and checks its header, so it takes constant time, allocates nothing, and the
+     *        processes serving a file share its pages in the page cache. Lookups follow the path of AltIndex::find,
+     *        with the same expected_position() and LinearModel::predict().
+     */
+    template <class KeyType, class ValueType>
+    class FrozenAltIndex
+    {
+        static_assert(std::is_integral<KeyType>::value && std::is_unsigned<KeyType>::value && sizeof(KeyType) <= 8,
+                      "the flattened buffer takes the bytes of unsigned integer keys, most significant first");
+
+    public:
+        typedef std::pair<KeyType, ValueType> payload;
+
+        // a GPL node in the file, the offsets are in bytes from the start of the file
+        struct FrozenNode
+        {
+            LinearModel<KeyType> model;
+            int numItems;
+            int expandNode; // index of the expand node, -1 if none
+            uint64_t bitmapOffset;
+            uint64_t keysOffset;
+            uint64_t valuesOffset;
+        };
+
+        /**
+         * @brief Map a frozen index file.
+         * @param path File written by build()
+         */
+        explicit FrozenAltIndex(const char *path) : base(nullptr), size(0), header(nullptr)
+        {
+            const int fd = open(path, O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(FrozenHeader)))
+            {
+                void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (mapped != MAP_FAILED)
+                {
+                    base = static_cast<const char *>(mapped);
+                    size = st.st_size;
+                }
+            }
+            close(fd);
+            if (base != nullptr && !checkHeader())
+            {
+                munmap(const_cast<char *>(base), size);
+                base = nullptr;
+            }
+            if (base == nullptr)
+                return;
+            header = reinterpret_cast<const FrozenHeader *>(base);
+            nodeKeys = at<KeyType>(header->nodeKeysOffset);
+            heads = at<int32_t>(header->headsOffset);
+            nodes = at<FrozenNode>(header->nodesOffset);
+            records = at<payload>(header->recordsOffset);
+            buffer = at<uint64_t>(header->bufferOffset);
+        }
+
+        FrozenAltIndex(const FrozenAltIndex &) = delete;
+
+        ~FrozenAltIndex()
+        {
+            if (base != nullptr)
+                munmap(const_cast<char *>(base), size);
+        }
+
+        // false if the file is missing, or is not a frozen index of these types
+        bool ok() const
+        {
+            return base != nullptr;
+        }
+
+        size_t fileSize() const
+        {
+            return size;
+        }
+
+        /**
+         * @brief Check the CRC-32C of the whole file, which reads all of it.
+         */
+        bool verify() const
+        {
+            if (base == nullptr)
+                return false;
+            uint32_t checksum;
+            memcpy(&checksum, base + header->dataSize, sizeof(checksum));
+            return crc32c(0, base, header->dataSize) == checksum;
+        }
+
+        /**
+         * @brief Find the value associated with a key.
+         * @param key Key
+         * @param exist Set to whether the key exists
+         * @return Value, 0 if the key doesn't exist.
+         */
+        ValueType find(const KeyType &key, bool &exist) const
+        {
+            exist = false;
+            if (base == nullptr || header->entryNum == 0)
+                return static_cast<ValueType>(0);
+            int node_pos = binary_search(nodeKeys, header->entryNum, key);
+            node_pos = node_pos < 0 ? 0 : node_pos;
+            const bool local_search = header->flags & FROZEN_FLAG_LOCAL_SEARCH;
+            const bool dynamic_retrain = header->flags & FROZEN_FLAG_DYNAMIC_RETRAIN;
+
+            const FrozenNode *node = &nodes[heads[node_pos]];
+            for (bool first = true;; first = false)
+            {
+                const int pos = AltIndex<KeyType, ValueType>::expected_position(node, key);
+                const bitmap_t *bitmap = at<bitmap_t>(node->bitmapOffset);
+                const KeyType *keys = at<KeyType>(node->keysOffset);
+                const ValueType *values = at<ValueType>(node->valuesOffset);
+                const bool expanded = dynamic_retrain && node->expandNode >= 0;
+                if (BITMAP_GET(bitmap, pos))
+                {
+                    // an empty predicted slot of a node that has not been expanded means the key is missing
+                    if (first && !expanded)
+                        return static_cast<ValueType>(0);
+                }
+                else if (keys[pos] == key)
+                {
+                    exist = true;
+                    return values[pos];
+                }
+
+                if (local_search)
+                {
+                    const int end = std::min(pos + 1 + static_cast<int>(header->window), node->numItems);
+                    int i = pos + 1;
+                    while (i < end && keys[i] != key)
+                        i++;
+                    if (i < end && !BITMAP_GET(bitmap, i))
+                    {
+                        exist = true;
+                        return values[i];
+                    }
+                }
+                if (!expanded)
+                    return findInBuffer(key, exist);
+                node = &nodes[node->expandNode];
+            }
+        }
+
+        /**
+         * @brief Write the frozen file of an index. Call it while no writes run; queued retraining tasks are waited for.
+         * @param index Index
+         * @param path File, replaced once it is complete
+         * @return False if the file could not be written.
+         */
+        static bool build(AltIndex<KeyType, ValueType> &index, const char *path)
+        {
+            typedef typename AltIndex<KeyType, ValueType>::Node Node;
+            index.waitForRetrain();
+            EpochGuard guard;
+
+            // nodes in directory order, each followed by its expand nodes
+            auto version = index.directory.current();
+            const int entry_num = version->getSize();
+            std::vector<Node *> chain_nodes;
+            std::vector<int32_t> heads(entry_num);
+            for (int i = 0; i < entry_num; i++)
+            {
+                heads[i] = chain_nodes.size();
+                for (Node *cur = version->node(i); cur != nullptr; cur = cur->expand ? cur->expandNode : nullptr)
+                    chain_nodes.push_back(cur);
+            }
+
+            std::vector<payload> buffered;
+            index.buffer->lookupRange(std::numeric_limits<KeyType>::min(), std::numeric_limits<KeyType>::max(), buffered);
+            // no node starts at word 0, so that a child word of 0 means no child
+            std::vector<uint64_t> words(1, 0);
+            const uint64_t root = buffered.empty() ? 0 : flatten(buffered, 0, buffered.size(), 0, words);
+
+            FrozenHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, FROZEN_MAGIC, sizeof(header.magic));
+            header.version = FROZEN_FORMAT_VERSION;
+            header.keySize = sizeof(KeyType);
+            header.valueSize = sizeof(ValueType);
+            header.flags = (USE_LOCAL_SEARCH ? FROZEN_FLAG_LOCAL_SEARCH : 0) |
+                           (USE_DYNAMIC_RETRAIN ? FROZEN_FLAG_DYNAMIC_RETRAIN : 0);
+            header.window = LOCAL_SEARCH_WINDOW;
+            header.entryNum = entry_num;
+            header.nodeNum = chain_nodes.size();
+            header.recordNum = buffered.size();
+            header.bufferRoot = root;
+            header.bufferWords = words.size();
+
+            // lay out the sections, then the slot arrays of the nodes
+            uint64_t offset = align(sizeof(FrozenHeader));
+            header.nodeKeysOffset = offset;
+            offset = align(offset + sizeof(KeyType) * entry_num);
+            header.headsOffset = offset;
+            offset = align(offset + sizeof(int32_t) * entry_num);
+            header.nodesOffset = offset;
+            offset = align(offset + sizeof(FrozenNode) * chain_nodes.size());
+            std::vector<FrozenNode> table(chain_nodes.size());
+            for (size_t i = 0; i < chain_nodes.size(); i++)
+            {
+                Node *node = chain_nodes[i];
+                FrozenNode &frozen = table[i];
+                frozen.model.a = node->model.a;
+                frozen.model.b = node->model.b;
+                frozen.numItems = node->numItems;
+                frozen.expandNode = node->expand && i + 1 < chain_nodes.size() &&
+                                            chain_nodes[i + 1] == node->expandNode
+                                        ? static_cast<int>(i + 1)
+                                        : -1;
+                frozen.bitmapOffset = offset;
+                offset = align(offset + sizeof(bitmap_t) * BITMAP_SIZE(node->numItems));
+                frozen.keysOffset = offset;
+                offset = align(offset + sizeof(KeyType) * node->numItems);
+                frozen.valuesOffset = offset;
+                offset = align(offset + sizeof(ValueType) * node->numItems);
+            }
+            header.recordsOffset = offset;
+            offset = align(offset + sizeof(payload) * buffered.size());
+            header.bufferOffset = offset;
+            header.dataSize = offset + sizeof(uint64_t) * words.size();
+
+            SnapshotWriter writer(path);
+            uint64_t written = 0;
+            auto put = [&](const void *data, size_t n, uint64_t at)
+            {
+                static const char zeros[FROZEN_ALIGNMENT] = {0};
+                for (; written < at; written += std::min<uint64_t>(FROZEN_ALIGNMENT, at - written))
+                    writer.writeBytes(zeros, std::min<uint64_t>(FROZEN_ALIGNMENT, at - written));
+                writer.writeBytes(data, n);
+                written += n;
+            };
+            put(&header, sizeof(header), 0);
+            put(version->keys, sizeof(KeyType) * entry_num, header.nodeKeysOffset);
+            put(heads.data(), sizeof(int32_t) * entry_num, header.headsOffset);
+            put(table.data(), sizeof(FrozenNode) * table.size(), header.nodesOffset);
+            std::vector<KeyType> keys;
+            std::vector<ValueType> values;
+            for (size_t i = 0; i < chain_nodes.size(); i++)
+            {
+                Node *node = chain_nodes[i];
+                keys.resize(node->numItems);
+                values.resize(node->numItems);
+                for (int pos = 0; pos < node->numItems; pos++)
+                {
+                    keys[pos] = node->slotKey(pos);
+                    values[pos] = node->slotValue(pos);
+                }
+                put(node->noneBitmap, sizeof(bitmap_t) * BITMAP_SIZE(node->numItems), table[i].bitmapOffset);
+                put(keys.data(), sizeof(KeyType) * keys.size(), table[i].keysOffset);
+                put(values.data(), sizeof(ValueType) * values.size(), table[i].valuesOffset);
+            }
+            put(buffered.data(), sizeof(payload) * buffered.size(), header.recordsOffset);
+            put(words.data(), sizeof(uint64_t) * words.size(), header.bufferOffset);
+            return writer.finish();
+        }
+
+    private:
+        static uint64_t align(uint64_t offset)
+        {
+            return (offset + FROZEN_ALIGNMENT - 1) / FROZEN_ALIGNMENT * FROZEN_ALIGNMENT;
+        }
+
+        template <class T>
+        const T *at(uint64_t offset) const
+        {
+            return reinterpret_cast<const T *>(base + offset);
+        }
+
+        // byte of a key at a depth, the most significant byte first
+        static inline unsigned keyByte(const KeyType &key, int depth)
+        {
+            return static_cast<unsigned>(key >> (8 * (sizeof(KeyType) - 1 - depth))) & 0xff;
+        }
+
+        /**
+         * @brief Flatten the buffered records [lo, hi), whose first depth bytes are equal, into a radix tree node
+         *        appended to words. A node is a word with its prefix length, kind and number of children, a word
+         *        with the prefix bytes, and either the sorted child bytes followed by the child words, or 256 child
+         *        words. A child word is 0 if missing, the word offset of a node shifted left, or the record index
+         *        shifted left with the low bit set.
+         * @return Child word of the node.
+         */
+        static uint64_t flatten(const std::vector<payload> &buffered, size_t lo, size_t hi, int depth,
+                                std::vector<uint64_t> &words)
+        {
+            if (hi - lo == 1)
+                return static_cast<uint64_t>(lo) << 1 | 1;
+            int prefix = 0;
+            while (keyByte(buffered[lo].first, depth + prefix) == keyByte(buffered[hi - 1].first, depth + prefix))
+                prefix++;
+            const int level = depth + prefix;
+
+            std::vector<size_t> bounds;
+            for (size_t i = lo; i < hi; i++)
+            {
+                if (i == lo || keyByte(buffered[i].first, level) != keyByte(buffered[i - 1].first, level))
+                    bounds.push_back(i);
+            }
+            bounds.push_back(hi);
+            const size_t count = bounds.size() - 1;
+            const bool dense = count > FROZEN_SPARSE_MAX;
+
+            const size_t node = words.size();
+            const size_t byte_words = dense ? 0 : (count + 7) / 8;
+            words.resize(node + 2 + byte_words + (dense ? 256 : count), 0);
+            words[node] = static_cast<uint64_t>(prefix) | static_cast<uint64_t>(dense) << 8 |
+                          static_cast<uint64_t>(count) << 16;
+            uint8_t *prefix_bytes = reinterpret_cast<uint8_t *>(&words[node + 1]);
+            for (int i = 0; i < prefix; i++)
+                prefix_bytes[i] = keyByte(buffered[lo].first, depth + i);
+            for (size_t c = 0; c < count; c++)
+            {
+                const unsigned byte = keyByte(buffered[bounds[c]].first, level);
+                const uint64_t child = flatten(buffered, bounds[c], bounds[c + 1], level + 1, words);
+                if (dense)
+                {
+                    words[node + 2 + byte] = child;
+                }
+                else
+                {
+                    reinterpret_cast<uint8_t *>(&words[node + 2])[c] = byte;
+                    words[node + 2 + byte_words + c] = child;
+                }
+            }
+            return static_cast<uint64_t>(node) << 1;
+        }
+
+        ValueType findInBuffer(const KeyType &key, bool &exist) const
+        {
+            uint64_t child = header->bufferRoot;
+            int depth = 0;
+            while (child != 0)
+            {
+                if (child & 1)
+                {
+                    const payload &record = records[child >> 1];
+                    exist = record.first == key;
+                    return exist ? record.second : static_cast<ValueType>(0);
+                }
+                const uint64_t *node = buffer + (child >> 1);
+                const int prefix = node[0] & 0xff;
+                const bool dense = (node[0] >> 8) & 0xff;
+                const size_t count = (node[0] >> 16) & 0xffff;
+                const uint8_t *prefix_bytes = reinterpret_cast<const uint8_t *>(node + 1);
+                for (int i = 0; i < prefix; i++)
+                {
+                    if (keyByte(key, depth + i) != prefix_bytes[i])
+                        return static_cast<ValueType>(0);
+                }
+                depth += prefix;
+                const unsigned byte = keyByte(key, depth++);
+                if (dense)
+                {
+                    child = node[2 + byte];
+                    continue;
+                }
+                const uint8_t *bytes = reinterpret_cast<const uint8_t *>(node + 2);
+                child = 0;
+                for (size_t c = 0; c < count && bytes[c] <= byte; c++)
+                {
+                    if (bytes[c] == byte)
+                    {
+                        child = node[2 + (count + 7) / 8 + c];
+                        break;
+                    }
+                }
+            }
+            return static_cast<ValueType>(0);
+        }
+
+        // the offsets of the header and of the nodes lie within the file
+        bool checkHeader() const
+        {
+            const FrozenHeader *h = reinterpret_cast<const FrozenHeader *>(base);
+            if (memcmp(h->magic, FROZEN_MAGIC, sizeof(h->magic)) != 0 || h->version != FROZEN_FORMAT_VERSION ||
+                h->keySize != sizeof(KeyType) || h->valueSize != sizeof(ValueType) ||
+                h->dataSize + sizeof(uint32_t) != size || h->entryNum < 0 || h->nodeNum < 0)
+                return false;
+            auto within = [&](uint64_t offset, uint64_t count, uint64_t bytes)
+            { return offset <= h->dataSize && count <= (h->dataSize - offset) / bytes; };
+            if (!within(h->nodeKeysOffset, h->entryNum, sizeof(KeyType)) ||
+                !within(h->headsOffset, h->entryNum, sizeof(int32_t)) ||
+                !within(h->nodesOffset, h->nodeNum, sizeof(FrozenNode)) ||
+                !within(h->recordsOffset, h->recordNum, sizeof(payload)) ||
+                !within(h->bufferOffset, h->bufferWords, sizeof(uint64_t)))
+                return false;
+            const FrozenNode *table = reinterpret_cast<const FrozenNode *>(base + h->nodesOffset);
+            for (int i = 0; i < h->nodeNum; i++)
+            {
+                const FrozenNode &node = table[i];
+                if (node.numItems <= 0 || node.expandNode >= h->nodeNum ||
+                    !within(node.bitmapOffset, BITMAP_SIZE(node.numItems), sizeof(bitmap_t)) ||
+                    !within(node.keysOffset, node.numItems, sizeof(KeyType)) ||
+                    !within(node.valuesOffset, node.numItems, sizeof(ValueType)))
+                    return false;
+            }
+            return true;
+        }
+
+        const char *base; // the mapped file
+        size_t size;
+        const FrozenHeader *header;
+        const KeyType *nodeKeys;
+        const int32_t *heads;
+        const FrozenNode *nodes;
+        const payload *records;
+        const uint64_t *buffer;
+    };
+}
+
+#endif // ALT_INDEX_FROZEN_H
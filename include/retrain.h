@@ -0,0 +1,113 @@
+#ifndef ALT_INDEX_RETRAIN_H
+#define ALT_INDEX_RETRAIN_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace alt_index
+{
+
+    /**
+     * @brief Thread pool running the retraining tasks of the GPL nodes (expand node builds and
+     *        evictions) off the insert path. Tasks are taken from a FIFO work queue.
+     *        Without threads, a task runs in the thread that submits it.
+     */
+    class RetrainService
+    {
+    public:
+        explicit RetrainService(int thread_num) : stop(false), running(0)
+        {
+            for (int i = 0; i < thread_num; i++)
+            {
+                workers.emplace_back([this]
+                                     { work(); });
+            }
+        }
+
+        RetrainService(const RetrainService &) = delete;
+
+        // pending tasks are finished before the workers exit
+        ~RetrainService()
+        {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                stop = true;
+            }
+            task_cv.notify_all();
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        /**
+         * @brief Queue a task, or run it right away if the service has no threads.
+         * @param task Task
+         */
+        void submit(std::function<void()> task)
+        {
+            if (workers.empty())
+            {
+                task();
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                tasks.push_back(std::move(task));
+            }
+            task_cv.notify_one();
+        }
+
+        /**
+         * @brief Wait until all submitted tasks have finished.
+         */
+        void drain()
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            idle_cv.wait(guard, [this]
+                         { return tasks.empty() && running == 0; });
+        }
+
+        int threadNum() const
+        {
+            return static_cast<int>(workers.size());
+        }
+
+    private:
+        void work()
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            while (true)
+            {
+                task_cv.wait(guard, [this]
+                             { return stop || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+
+                std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                running++;
+                guard.unlock();
+                task();
+                guard.lock();
+                running--;
+                if (tasks.empty() && running == 0)
+                    idle_cv.notify_all();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable task_cv; // signals queued tasks and stop
+        std::condition_variable idle_cv; // signals an empty queue with no running task
+        bool stop;
+        int running; // tasks taken from the queue and not finished
+    };
+}
+
+#endif // ALT_INDEX_RETRAIN_H
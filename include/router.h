@@ -0,0 +1,303 @@
+#ifndef ALT_INDEX_ROUTER_H
+#define ALT_INDEX_ROUTER_H
+
+#include "utils.h"
+#include "linear_model.h"
+#include <stdint.h>
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <type_traits>
+
+#define LEARNED_ROUTER_LEAF_KEYS 64 // average number of node keys covered by a leaf model of the learned router
+#define BTREE_ROUTER_BLOCK 8        // keys per block of the B-tree router, 8 * 8 bytes is one cache line
+
+namespace alt_index
+{
+
+    // the way the top level locates the GPL node of a key
+    enum class RouterType
+    {
+        BinarySearch, // branchless binary search over node_keys
+        Learned,      // two-layer learned model over node_keys with bounded last-mile search
+        BTree         // cache-aligned implicit B-tree layout with SIMD comparisons
+    };
+
+    /**
+     * @brief Root router over the sorted node_keys of the GPL nodes.
+     *        route() always returns the same position as binary_search() over the same keys,
+     *        i.e. the last node key not greater than the key, or -1 if the key is smaller than all of them.
+     *        The router is built over the first n keys; keys appended afterwards are searched in the tail.
+     */
+    template <class KeyType>
+    class NodeRouter
+    {
+        // a leaf model of the learned router
+        struct LeafModel
+        {
+            double a;   // slope of the position within node_keys
+            double b;   // intercept of the position within node_keys
+            int start;  // first position covered by the leaf
+            int error;  // max prediction error of the leaf
+
+            inline double predict_double(const KeyType &key) const
+            {
+                return a * static_cast<double>(key) + b;
+            }
+        };
+
+    public:
+        explicit NodeRouter(RouterType type = RouterType::BinarySearch)
+            : type_(type), built_num(0), leaf_num(0), block_num(0), block_keys(nullptr), block_pos(nullptr) {}
+
+        NodeRouter(const NodeRouter &) = delete;
+
+        ~NodeRouter()
+        {
+            free(block_keys);
+            free(block_pos);
+        }
+
+        RouterType type() const
+        {
+            return type_;
+        }
+
+        /**
+         * @brief Build the router over sorted node keys.
+         * @param keys Array of node keys
+         * @param n Number of node keys
+         */
+        void build(const KeyType *keys, int n)
+        {
+            built_num = n;
+            if (n <= 1)
+                return;
+
+            if (type_ == RouterType::Learned)
+            {
+                buildLearned(keys, n);
+            }
+            else if (type_ == RouterType::BTree)
+            {
+                buildBTree(keys, n);
+            }
+        }
+
+        /**
+         * @brief Locate the node of a key.
+         * @param keys Array of node keys, the first n keys are the ones the router was built on
+         * @param n Current number of node keys
+         * @param key Key
+         * @return Position of the last node key not greater than key, -1 if key is smaller than all node keys.
+         */
+        inline int route(const KeyType *keys, int n, const KeyType &key) const
+        {
+            if (type_ == RouterType::BinarySearch || built_num <= 1 || n == 1)
+                return binary_search(keys, n, key);
+
+            // keys appended after the router was built
+            if (key >= keys[built_num - 1])
+            {
+                if (n == built_num)
+                    return n - 1;
+                return built_num - 1 + binary_search(keys + built_num - 1, n - built_num + 1, key);
+            }
+            if (key < keys[0])
+                return -1;
+
+            if (type_ == RouterType::Learned)
+                return routeLearned(keys, key);
+            return routeBTree(key);
+        }
+
+        /**
+         * @brief Memory used by the router on top of node_keys.
+         */
+        long long memoryConsumption() const
+        {
+            return sizeof(LeafModel) * leaves.size() +
+                   (sizeof(KeyType) + sizeof(int)) * BTREE_ROUTER_BLOCK * static_cast<long long>(block_num);
+        }
+
+    private:
+        // ---------------- learned router ----------------
+
+        void buildLearned(const KeyType *keys, int n)
+        {
+            leaf_num = std::max(1, n / LEARNED_ROUTER_LEAF_KEYS);
+            leaves.assign(leaf_num, LeafModel());
+
+            // root model maps the key range linearly onto the leaves
+            root_model.a = static_cast<double>(leaf_num) / (static_cast<double>(keys[n - 1]) - static_cast<double>(keys[0]));
+            root_model.b = 0.0 - root_model.a * static_cast<double>(keys[0]);
+
+            // the root model is monotone, so each leaf covers a contiguous run of node keys
+            int pos = 0;
+            for (int leaf = 0; leaf < leaf_num; leaf++)
+            {
+                int start = pos;
+                while (pos < n && leafOf(keys[pos]) == leaf)
+                    pos++;
+                fitLeaf(keys, start, pos, leaves[leaf]);
+            }
+            leaves_end = n;
+        }
+
+        // fit the leaf model over keys[start, end)
+        void fitLeaf(const KeyType *keys, int start, int end, LeafModel &leaf)
+        {
+            leaf.start = start;
+            if (end - start <= 1)
+            {
+                leaf.a = 0.0;
+                leaf.b = start;
+                leaf.error = 1;
+                return;
+            }
+
+            leaf.a = (end - start - 1) / (static_cast<double>(keys[end - 1]) - static_cast<double>(keys[start]));
+            leaf.b = start - leaf.a * static_cast<double>(keys[start]);
+
+            double max_error = 0.0;
+            for (int i = start; i < end; i++)
+            {
+                double error = std::fabs(leaf.predict_double(keys[i]) - i);
+                if (error > max_error)
+                    max_error = error;
+            }
+            // a key between two node keys is predicted between their predictions
+            leaf.error = static_cast<int>(std::ceil(max_error)) + 2;
+        }
+
+        inline int leafOf(const KeyType &key) const
+        {
+            int leaf = root_model.predict(key);
+            if (leaf < 0)
+                return 0;
+            return leaf >= leaf_num ? leaf_num - 1 : leaf;
+        }
+
+        inline int routeLearned(const KeyType *keys, const KeyType &key) const
+        {
+            const int leaf = leafOf(key);
+            const LeafModel &model = leaves[leaf];
+            const int end = (leaf + 1 < leaf_num) ? leaves[leaf + 1].start : leaves_end;
+
+            // the answer lies in [start - 1, end - 1], narrowed by the error bound of the leaf
+            const int predict = static_cast<int>(model.predict_double(key));
+            int lo = std::max(std::max(model.start - 1, 0), predict - model.error);
+            int hi = std::min(end - 1, predict + model.error);
+            if (hi < lo)
+            {
+                lo = std::max(model.start - 1, 0);
+                hi = end - 1;
+            }
+            if (hi == lo)
+                return lo;
+            return lo + binary_search(keys + lo, hi - lo + 1, key);
+        }
+
+        // ---------------- B-tree router ----------------
+
+        // index of the i-th child of block k in the implicit (BTREE_ROUTER_BLOCK + 1)-ary tree
+        static inline int child(int k, int i)
+        {
+            return k * (BTREE_ROUTER_BLOCK + 1) + i + 1;
+        }
+
+        void buildBTree(const KeyType *keys, int n)
+        {
+            free(block_keys);
+            free(block_pos);
+
+            block_num = (n + BTREE_ROUTER_BLOCK - 1) / BTREE_ROUTER_BLOCK;
+            const size_t bytes = sizeof(KeyType) * BTREE_ROUTER_BLOCK * static_cast<size_t>(block_num);
+            block_keys = static_cast<KeyType *>(aligned_alloc(64, (bytes + 63) / 64 * 64));
+            block_pos = static_cast<int *>(malloc(sizeof(int) * BTREE_ROUTER_BLOCK * static_cast<size_t>(block_num)));
+            assert(block_keys != nullptr && block_pos != nullptr);
+
+            int next = 0;
+            fillBTree(keys, n, 0, next);
+        }
+
+        // in-order fill so that the blocks form a search tree over the sorted keys
+        void fillBTree(const KeyType *keys, int n, int k, int &next)
+        {
+            if (k >= block_num)
+                return;
+            for (int i = 0; i < BTREE_ROUTER_BLOCK; i++)
+            {
+                fillBTree(keys, n, child(k, i), next);
+                if (next < n)
+                {
+                    block_keys[k * BTREE_ROUTER_BLOCK + i] = keys[next];
+                    block_pos[k * BTREE_ROUTER_BLOCK + i] = next;
+                    next++;
+                }
+                else
+                {
+                    block_keys[k * BTREE_ROUTER_BLOCK + i] = std::numeric_limits<KeyType>::max();
+                    block_pos[k * BTREE_ROUTER_BLOCK + i] = -1;
+                }
+            }
+            fillBTree(keys, n, child(k, BTREE_ROUTER_BLOCK), next);
+        }
+
+        // number of keys in a block not greater than key
+        template <class T = KeyType>
+        static inline typename std::enable_if<std::is_same<T, uint64_t>::value, int>::type
+        countNotGreater(const T *block, const T &key)
+        {
+            const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(1ull << 63));
+            const __m256i key_vec = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), sign);
+            __m256i lo = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i *>(block)), sign);
+            __m256i hi = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i *>(block + 4)), sign);
+            int greater = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(lo, key_vec))) |
+                          (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(hi, key_vec))) << 4);
+            return BTREE_ROUTER_BLOCK - __builtin_popcount(greater);
+        }
+
+        template <class T = KeyType>
+        static inline typename std::enable_if<!std::is_same<T, uint64_t>::value, int>::type
+        countNotGreater(const T *block, const T &key)
+        {
+            int count = 0;
+            for (int i = 0; i < BTREE_ROUTER_BLOCK; i++)
+                count += (block[i] <= key);
+            return count;
+        }
+
+        inline int routeBTree(const KeyType &key) const
+        {
+            int ret = -1;
+            int k = 0;
+            while (k < block_num)
+            {
+                const int count = countNotGreater(block_keys + k * BTREE_ROUTER_BLOCK, key);
+                // the largest key not greater than key in this block, deeper blocks only refine it
+                if (count > 0)
+                    ret = k * BTREE_ROUTER_BLOCK + count - 1;
+                k = child(k, count);
+            }
+            return ret < 0 ? -1 : block_pos[ret];
+        }
+
+    private:
+        RouterType type_;
+        int built_num; // number of node keys the router was built on
+
+        // learned router
+        LinearModel<KeyType> root_model;
+        std::vector<LeafModel> leaves;
+        int leaf_num;
+        int leaves_end;
+
+        // B-tree router
+        int block_num;
+        KeyType *block_keys;
+        int *block_pos;
+    };
+}
+
+#endif // ALT_INDEX_ROUTER_H
@@ -0,0 +1,220 @@
+#ifndef ALT_INDEX_SNAPSHOT_H
+#define ALT_INDEX_SNAPSHOT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#define SNAPSHOT_FORMAT_VERSION 2
+#define SNAPSHOT_IO_BUFFER (1 << 20) // bytes of the stdio buffer, larger reads and writes bypass it
+#define SNAPSHOT_STAGE_SLOTS 4096    // slots gathered at once between the file and interleaved slot arrays
+
+namespace alt_index
+{
+    static const char SNAPSHOT_MAGIC[8] = {'A', 'L', 'T', 'S', 'N', 'A', 'P', '\0'};
+
+    // first bytes of a snapshot file
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;   // SNAPSHOT_FORMAT_VERSION
+        uint32_t keySize;   // sizeof(KeyType)
+        uint32_t valueSize; // sizeof(ValueType)
+        uint32_t reserved;
+        uint64_t logPosition; // sequence number of the first write-ahead log record not in the snapshot
+    };
+
+    /**
+     * @brief CRC-32C of a byte range, with the SSE4.2 instruction if it is available.
+     * @param crc CRC of the preceding bytes, 0 for the first range
+     * @param data Bytes
+     * @param n Number of bytes
+     * @return CRC of the preceding bytes and the range.
+     */
+    inline uint32_t crc32c(uint32_t crc, const void *data, size_t n)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        crc = ~crc;
+#ifdef __SSE4_2__
+        uint64_t crc64 = crc;
+        for (; n >= 8; n -= 8, p += 8)
+        {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            crc64 = _mm_crc32_u64(crc64, word);
+        }
+        crc = static_cast<uint32_t>(crc64);
+        for (; n > 0; n--, p++)
+            crc = _mm_crc32_u8(crc, *p);
+#else
+        struct Table
+        {
+            uint32_t entries[256];
+            Table()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t entry = i;
+                    for (int bit = 0; bit < 8; bit++)
+                        entry = (entry >> 1) ^ (0x82F63B78u & (0u - (entry & 1)));
+                    entries[i] = entry;
+                }
+            }
+        };
+        static const Table table;
+        for (; n > 0; n--, p++)
+            crc = (crc >> 8) ^ table.entries[(crc ^ *p) & 0xff];
+#endif
+        return ~crc;
+    }
+
+    /**
+     * @brief Sequential writer of a snapshot file. The bytes go to a temporary file next to the target, with
+     *        their CRC-32C appended by finish(), which then renames it over the target, so that the target is
+     *        either the old snapshot or the complete new one.
+     */
+    class SnapshotWriter
+    {
+    public:
+        explicit SnapshotWriter(const char *path) : path(path), tmpPath(std::string(path) + ".tmp"), crc(0), failed(false)
+        {
+            file = fopen(tmpPath.c_str(), "wb");
+            failed = file == nullptr;
+            if (file != nullptr)
+                setvbuf(file, nullptr, _IOFBF, SNAPSHOT_IO_BUFFER);
+        }
+
+        SnapshotWriter(const SnapshotWriter &) = delete;
+
+        ~SnapshotWriter()
+        {
+            if (file != nullptr)
+            {
+                fclose(file);
+                std::remove(tmpPath.c_str());
+            }
+        }
+
+        void writeBytes(const void *data, size_t n)
+        {
+            if (failed || n == 0)
+                return;
+            crc = crc32c(crc, data, n);
+            failed = fwrite(data, 1, n, file) != n;
+        }
+
+        template <class T>
+        void write(const T &value)
+        {
+            writeBytes(&value, sizeof(T));
+        }
+
+        /**
+         * @brief Append the checksum and move the file to its place.
+         * @return False if any write failed, the target is left as it was then.
+         */
+        bool finish()
+        {
+            if (file == nullptr)
+                return false;
+            const uint32_t checksum = crc;
+            if (!failed)
+                failed = fwrite(&checksum, sizeof(checksum), 1, file) != 1;
+            failed |= fclose(file) != 0;
+            file = nullptr;
+            if (!failed)
+                failed = std::rename(tmpPath.c_str(), path.c_str()) != 0;
+            if (failed)
+                std::remove(tmpPath.c_str());
+            return !failed;
+        }
+
+    private:
+        FILE *file;
+        std::string path;
+        std::string tmpPath;
+        uint32_t crc;
+        bool failed;
+    };
+
+    /**
+     * @brief Sequential reader of a snapshot file, which checks the CRC-32C of the bytes read in finish().
+     *        Counts read from the file are checked against the bytes left before anything is allocated for them.
+     */
+    class SnapshotReader
+    {
+    public:
+        explicit SnapshotReader(const char *path) : remaining(0), crc(0), failed(false)
+        {
+            file = fopen(path, "rb");
+            failed = file == nullptr;
+            if (file != nullptr)
+            {
+                setvbuf(file, nullptr, _IOFBF, SNAPSHOT_IO_BUFFER);
+                failed = fseek(file, 0, SEEK_END) != 0;
+                const long size = failed ? -1 : ftell(file);
+                failed = size < 0 || fseek(file, 0, SEEK_SET) != 0;
+                remaining = failed ? 0 : static_cast<size_t>(size);
+            }
+        }
+
+        SnapshotReader(const SnapshotReader &) = delete;
+
+        ~SnapshotReader()
+        {
+            if (file != nullptr)
+                fclose(file);
+        }
+
+        // false once a read has failed, the following reads do nothing
+        bool readBytes(void *data, size_t n)
+        {
+            if (failed || n == 0)
+                return !failed;
+            failed = n > remaining || fread(data, 1, n, file) != n;
+            if (!failed)
+            {
+                remaining -= n;
+                crc = crc32c(crc, data, n);
+            }
+            return !failed;
+        }
+
+        // whether count objects of size bytes may follow, false for a negative count
+        bool fits(long long count, size_t size) const
+        {
+            return !failed && count >= 0 && static_cast<unsigned long long>(count) <= remaining / size;
+        }
+
+        template <class T>
+        bool read(T &value)
+        {
+            return readBytes(&value, sizeof(T));
+        }
+
+        /**
+         * @brief Check the checksum at the end of the file.
+         * @return False if a read failed, the checksum differs, or bytes follow it.
+         */
+        bool finish()
+        {
+            if (failed)
+                return false;
+            uint32_t checksum;
+            failed = fread(&checksum, sizeof(checksum), 1, file) != 1 || checksum != crc || fgetc(file) != EOF;
+            return !failed;
+        }
+
+    private:
+        FILE *file;
+        size_t remaining; // bytes left in the file
+        uint32_t crc;
+        bool failed;
+    };
+}
+
+#endif // ALT_INDEX_SNAPSHOT_H
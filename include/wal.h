@@ -0,0 +1,335 @@
+#ifndef ALT_INDEX_WAL_H
+#define ALT_INDEX_WAL_H
+
+#include "snapshot.h"
+#include "tbb/enumerable_thread_specific.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAL_FORMAT_VERSION 1
+// microseconds a group commit leader waits for more writers before it writes and syncs, 0 for none
+#ifndef WAL_GROUP_DELAY_US
+#define WAL_GROUP_DELAY_US 0
+#endif
+
+namespace alt_index
+{
+    static const char WAL_MAGIC[8] = {'A', 'L', 'T', 'W', 'A', 'L', '\0', '\0'};
+
+    enum class WalOp : uint32_t
+    {
+        Insert = 1,
+        Update = 2,
+        Remove = 3
+    };
+
+    // first bytes of a log file
+    struct WalHeader
+    {
+        char magic[8];
+        uint32_t version;       // WAL_FORMAT_VERSION
+        uint32_t keySize;       // sizeof(KeyType)
+        uint32_t valueSize;     // sizeof(ValueType)
+        uint32_t reserved;
+        uint64_t startSequence; // sequence number of the first record in the file
+    };
+
+    // the records written by one group commit follow this header
+    struct WalBlock
+    {
+        uint64_t firstSequence;
+        uint32_t count;
+        uint32_t crc; // CRC-32C of firstSequence, count and the records
+    };
+
+    /**
+     * @brief Write-ahead log of the writes of an index. Writers append records to a log buffer of their own thread,
+     *        and commit() hands the buffer of the calling thread to a group commit: the first committing writer
+     *        becomes the leader, optionally waits group_delay_us for more writers, and writes the records of all
+     *        waiting writers as one checksummed block followed by a single fdatasync, while the others wait for it.
+     *        Records are numbered in commit order. A torn block at the end of the file is dropped when it is opened.
+     */
+    template <class KeyType, class ValueType>
+    class WriteAheadLog
+    {
+    public:
+        struct Record
+        {
+            KeyType key;
+            ValueType value;
+            WalOp op;
+        };
+
+        /**
+         * @brief Open a log file and go on after its last complete block, or create it if it is missing or empty.
+         * @param path File
+         * @param group_delay_us Microseconds the leader of a group commit waits for more writers
+         * @param sync Whether a group commit waits for fdatasync; without it, records survive crashes of the
+         *        process but not of the machine
+         */
+        explicit WriteAheadLog(const char *path, int group_delay_us = WAL_GROUP_DELAY_US, bool sync = true)
+            : groupDelay(group_delay_us), sync(sync), failed(false), flushing(false), fileEnd(0),
+              queuedSequence(0), durableSequence(0), syncs(0)
+        {
+            fd = open(path, O_RDWR | O_CREAT, 0644);
+            failed = fd < 0 || !scan();
+        }
+
+        WriteAheadLog(const WriteAheadLog &) = delete;
+
+        ~WriteAheadLog()
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+
+        // false if the file could not be opened, is not a log of these types, or a write failed
+        bool ok() const
+        {
+            return !failed.load(std::memory_order_acquire);
+        }
+
+        // sequence number of the next record, the number of records logged since the log was created
+        uint64_t sequence()
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            return durableSequence;
+        }
+
+        // group commits written so far
+        long long syncCount() const
+        {
+            return syncs.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Add a record to the log buffer of the calling thread, it is written by the next commit() of the thread.
+         */
+        void append(WalOp op, const KeyType &key, const ValueType &value)
+        {
+            Record record;
+            // padding bytes are checksummed as well
+            memset(&record, 0, sizeof(record));
+            record.key = key;
+            record.value = value;
+            record.op = op;
+            threadRecords.local().push_back(record);
+        }
+
+        /**
+         * @brief Make the records appended by the calling thread durable, together with those of the
+         *        threads committing at the same time.
+         * @return False if the log failed to write them.
+         */
+        bool commit()
+        {
+            std::vector<Record> &local = threadRecords.local();
+            if (local.empty())
+                return ok();
+            std::unique_lock<std::mutex> lock(mutex);
+            pending.insert(pending.end(), local.begin(), local.end());
+            queuedSequence += local.size();
+            local.clear();
+            const uint64_t target = queuedSequence;
+            while (durableSequence < target && ok())
+            {
+                if (flushing)
+                {
+                    flushed.wait(lock);
+                    continue;
+                }
+                // lead a group commit of all records queued until the delay is over
+                flushing = true;
+                if (groupDelay > 0)
+                {
+                    lock.unlock();
+                    std::this_thread::sleep_for(std::chrono::microseconds(groupDelay));
+                    lock.lock();
+                }
+                writing.swap(pending);
+                const uint64_t first = durableSequence;
+                lock.unlock();
+                const bool written = writeBlock(first, writing);
+                lock.lock();
+                if (written)
+                    durableSequence += writing.size();
+                else
+                    failed.store(true, std::memory_order_release);
+                writing.clear();
+                flushing = false;
+                flushed.notify_all();
+            }
+            return durableSequence >= target;
+        }
+
+        /**
+         * @brief Call fn(record) on the records from a sequence number on, in sequence order.
+         *        Not to be called while records are committed.
+         * @param from Sequence number of the first record, e.g. the log position of a snapshot
+         * @param fn Function called on each record
+         * @return Number of records passed to fn.
+         */
+        template <typename Function>
+        long long replay(uint64_t from, Function fn)
+        {
+            long long replayed = 0;
+            forEachBlock([&](uint64_t first, const std::vector<Record> &records)
+                         {
+                             for (size_t i = 0; i < records.size(); i++)
+                             {
+                                 if (first + i >= from)
+                                 {
+                                     fn(records[i]);
+                                     replayed++;
+                                 }
+                             } });
+            return replayed;
+        }
+
+        /**
+         * @brief Drop all records, e.g. once a snapshot holds them. Not to be called while records are committed.
+         * @param start_sequence Sequence number of the next record
+         * @return False if the file could not be rewritten.
+         */
+        bool reset(uint64_t start_sequence)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            const bool written = ftruncate(fd, 0) == 0 && writeHeader(start_sequence) && fdatasync(fd) == 0;
+            if (!written)
+                failed.store(true, std::memory_order_release);
+            queuedSequence = durableSequence = start_sequence;
+            return written;
+        }
+
+    private:
+        static bool writeAll(int fd, const void *data, size_t n, off_t offset)
+        {
+            const char *p = static_cast<const char *>(data);
+            while (n > 0)
+            {
+                const ssize_t written = pwrite(fd, p, n, offset);
+                if (written <= 0)
+                    return false;
+                p += written;
+                n -= written;
+                offset += written;
+            }
+            return true;
+        }
+
+        bool writeHeader(uint64_t start_sequence)
+        {
+            WalHeader header;
+            memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+            header.version = WAL_FORMAT_VERSION;
+            header.keySize = sizeof(KeyType);
+            header.valueSize = sizeof(ValueType);
+            header.reserved = 0;
+            header.startSequence = start_sequence;
+            fileEnd = sizeof(header);
+            return writeAll(fd, &header, sizeof(header), 0);
+        }
+
+        uint32_t blockCrc(const WalBlock &block, const std::vector<Record> &records) const
+        {
+            const uint32_t crc = crc32c(0, &block, offsetof(WalBlock, crc));
+            return crc32c(crc, records.data(), sizeof(Record) * records.size());
+        }
+
+        bool writeBlock(uint64_t first, const std::vector<Record> &records)
+        {
+            WalBlock block;
+            memset(&block, 0, sizeof(block));
+            block.firstSequence = first;
+            block.count = records.size();
+            block.crc = blockCrc(block, records);
+            const size_t bytes = sizeof(Record) * records.size();
+            if (!writeAll(fd, &block, sizeof(block), fileEnd) ||
+                !writeAll(fd, records.data(), bytes, fileEnd + sizeof(block)))
+                return false;
+            if (sync && fdatasync(fd) != 0)
+                return false;
+            fileEnd += sizeof(block) + bytes;
+            syncs.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // call fn(first sequence, records) on the complete blocks from the start of the file, return their end
+        template <typename Function>
+        off_t forEachBlock(Function fn)
+        {
+            struct stat st;
+            WalHeader header;
+            if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header))
+                return -1;
+            off_t offset = sizeof(header);
+            uint64_t expected = header.startSequence;
+            std::vector<Record> records;
+            while (true)
+            {
+                WalBlock block;
+                if (offset + static_cast<off_t>(sizeof(block)) > st.st_size ||
+                    pread(fd, &block, sizeof(block), offset) != sizeof(block) || block.firstSequence != expected ||
+                    block.count == 0 ||
+                    block.count > (st.st_size - offset - sizeof(block)) / sizeof(Record))
+                    break;
+                records.resize(block.count);
+                const size_t bytes = sizeof(Record) * block.count;
+                if (pread(fd, records.data(), bytes, offset + sizeof(block)) != static_cast<ssize_t>(bytes) ||
+                    blockCrc(block, records) != block.crc)
+                    break;
+                fn(expected, records);
+                offset += sizeof(block) + bytes;
+                expected += block.count;
+            }
+            return offset;
+        }
+
+        // check the header and find the end of the last complete block, the rest of the file is cut
+        bool scan()
+        {
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+                return false;
+            if (st.st_size == 0)
+                return writeHeader(0) && fdatasync(fd) == 0;
+            WalHeader header;
+            if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+                memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0 || header.version != WAL_FORMAT_VERSION ||
+                header.keySize != sizeof(KeyType) || header.valueSize != sizeof(ValueType))
+                return false;
+            uint64_t end = header.startSequence;
+            fileEnd = forEachBlock([&](uint64_t first, const std::vector<Record> &records)
+                                   { end = first + records.size(); });
+            queuedSequence = durableSequence = end;
+            return fileEnd > 0 && (fileEnd == st.st_size || ftruncate(fd, fileEnd) == 0);
+        }
+
+        int fd;
+        const int groupDelay;
+        const bool sync;
+        std::atomic<bool> failed;
+        bool flushing;               // a leader is writing a group
+        off_t fileEnd;               // end of the last complete block, written by the leader only
+        uint64_t queuedSequence;     // sequence number after the last committed record
+        uint64_t durableSequence;    // sequence number after the last written record
+        std::atomic<long long> syncs;
+        std::mutex mutex;
+        std::condition_variable flushed;
+        std::vector<Record> pending; // records committed since the leader took the last group
+        std::vector<Record> writing; // records of the group the leader writes
+        tbb::enumerable_thread_specific<std::vector<Record>> threadRecords;
+    };
+}
+
+#endif // ALT_INDEX_WAL_H
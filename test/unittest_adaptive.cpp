@@ -0,0 +1,70 @@
+//
+// Buffer lookups under a skewed workload before and after adapting the fast pointers to their heat.
+// usage: unittest_adaptive [number of keys] [number of queries]
+//
+
+#define USE_ADAPTIVE_FAST_POINTER true
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 2000000
+#define QUERY_NUMBER 2000000
+#define HOT_SHARE 0.01 // share of the keys that get most queries
+#define HOT_QUERIES 0.9
+
+static void runQueries(AltIndex<uint64_t, uint64_t> &index, const vector<uint64_t> &queries, const char *name)
+{
+    size_t missing = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto query : queries)
+    {
+        bool exist;
+        uint64_t value = index.find(query, exist);
+        missing += !exist || value != query + 1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+    std::cout << name << ": " << queries.size() / seconds << " lookups/sec, average skipped depth "
+              << index.averageSkippedDepth() << ", not found " << missing << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int query_num = argc > 2 ? atoi(argv[2]) : QUERY_NUMBER;
+    std::mt19937_64 rng(2023);
+
+    // clustered keys, so that the buffer gets conflicts
+    vector<uint64_t> keys(key_num);
+    for (auto &key : keys)
+        key = (rng() % 4096) << 40 | (rng() % (1ULL << 24) + 1);
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], keys[i] + 1};
+
+    // most queries go to a contiguous slice of the keys
+    const size_t hot_num = max<size_t>(1, keys.size() * HOT_SHARE);
+    const size_t hot_first = rng() % (keys.size() - hot_num + 1);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    vector<uint64_t> queries(query_num);
+    for (auto &query : queries)
+        query = coin(rng) < HOT_QUERIES ? keys[hot_first + rng() % hot_num] : keys[rng() % keys.size()];
+
+    AltIndex<uint64_t, uint64_t> index;
+    index.bulkLoad(data.data(), data.size());
+    runQueries(index, queries, "fast pointers of the key ranges");
+    // the sampled queries above are the heat the fast pointers adapt to
+    const int hot_nodes = index.adaptFastPointers();
+    runQueries(index, queries, "adapted fast pointers");
+    std::cout << "nodes " << index.directory.size() << ", hot nodes " << hot_nodes << std::endl;
+    return 0;
+}
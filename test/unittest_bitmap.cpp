@@ -0,0 +1,56 @@
+//
+// Walking the occupied slots of a bitmap bit by bit against a word at a time, at several occupancies.
+// usage: unittest_bitmap [number of slots]
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+
+using namespace std;
+using namespace alt_index;
+
+#define SLOT_NUMBER (1 << 24)
+
+int main(int argc, char **argv)
+{
+    const int slot_num = argc > 1 ? atoi(argv[1]) : SLOT_NUMBER;
+    std::mt19937_64 rng(2023);
+
+    for (int every : {2, 3, 16, 256})
+    {
+        vector<bitmap_t> bitmap(BITMAP_SIZE(slot_num), ~bitmap_t(0));
+        for (int i = 0; i < slot_num; i++)
+            if (rng() % every == 0)
+                BITMAP_CLEAR(bitmap.data(), i);
+
+        vector<int> by_bit, by_word;
+        by_bit.reserve(slot_num);
+        by_word.reserve(slot_num);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < slot_num; i++)
+            if (!BITMAP_GET(bitmap.data(), i))
+                by_bit.push_back(i);
+        auto middle = std::chrono::high_resolution_clock::now();
+        OccupiedSlots occupied(bitmap.data(), 0, slot_num);
+        for (int i = occupied.next(); i < slot_num; i = occupied.next())
+            by_word.push_back(i);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // counts of random ranges against the walk
+        size_t wrong = by_bit != by_word;
+        for (int i = 0; i < 1000; i++)
+        {
+            int first = rng() % slot_num, last = first + rng() % (slot_num - first + 1);
+            wrong += bitmap_count_occupied(bitmap.data(), first, last) !=
+                     lower_bound(by_bit.begin(), by_bit.end(), last) - lower_bound(by_bit.begin(), by_bit.end(), first);
+        }
+        std::cout << "1/" << every << " occupied: bit by bit "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count() << " us, by word "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(end - middle).count() << " us, wrong "
+                  << wrong << std::endl;
+    }
+    return 0;
+}
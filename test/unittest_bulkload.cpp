@@ -0,0 +1,59 @@
+//
+// Bulk load throughput against the number of threads.
+// usage: unittest_bulkload [number of keys] [most threads]
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 10000000
+#define QUERY_NUMBER 1000000
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int max_threads = argc > 2 ? atoi(argv[2]) : max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::mt19937_64 rng(2023);
+
+    // clustered keys, so that the buffer gets conflicts
+    vector<uint64_t> keys(key_num);
+    for (auto &key : keys)
+        key = (rng() % 4096) << 40 | (rng() % (1ULL << 24) + 1);
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], keys[i] + 1};
+
+    vector<uint64_t> queries(QUERY_NUMBER);
+    for (auto &query : queries)
+        query = keys[rng() % keys.size()];
+
+    for (int thread_num = 1; thread_num <= max_threads; thread_num *= 2)
+    {
+        AltIndex<uint64_t, uint64_t> index;
+        auto start = std::chrono::high_resolution_clock::now();
+        index.bulkLoad(data.data(), data.size(), thread_num);
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+        size_t missing = 0;
+        for (auto query : queries)
+        {
+            bool exist;
+            uint64_t value = index.find(query, exist);
+            missing += !exist || value != query + 1;
+        }
+        std::cout << "threads " << thread_num << ": " << data.size() / seconds << " keys/sec, " << seconds
+                  << " s, nodes " << index.directory.size() << ", not found " << missing << std::endl;
+    }
+    return 0;
+}
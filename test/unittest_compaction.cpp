@@ -0,0 +1,106 @@
+//
+// Buffer size and lookup latency before and after merging the ART buffer back into the GPL nodes.
+// The compaction runs on a maintenance thread while lookups go on.
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 2000000
+#define INSERT_NUMBER 1000000
+
+static size_t bufferSize(AltIndex<uint64_t, uint64_t> &index)
+{
+    vector<pair<uint64_t, uint64_t>> records;
+    index.buffer->lookupRange(0, numeric_limits<uint64_t>::max(), records);
+    return records.size();
+}
+
+static double lookupLatency(AltIndex<uint64_t, uint64_t> &index, const vector<uint64_t> &queries, size_t &missing)
+{
+    bool exist;
+    missing = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto query : queries)
+    {
+        index.find(query, exist);
+        missing += !exist;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    return static_cast<double>(elapsed.count()) / queries.size();
+}
+
+int main()
+{
+    std::mt19937_64 rng(2023);
+
+    // clustered keys, so that the bulk loaded segments leave keys in the buffer
+    vector<uint64_t> keys(BULK_NUMBER);
+    for (auto &key : keys)
+        key = ((rng() % 4096) << 40 | (rng() % (1ULL << 20) + 1)) << 1;
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], keys[i]};
+
+    AltIndex<uint64_t, uint64_t> index;
+    index.bulkLoad(data.data(), data.size());
+
+    // inserts drift into a part of the key space
+    vector<uint64_t> inserts(INSERT_NUMBER);
+    for (auto &key : inserts)
+        key = (((rng() % 256) << 40 | (rng() % (1ULL << 30))) << 1) | 1;
+    sort(inserts.begin(), inserts.end());
+    inserts.erase(unique(inserts.begin(), inserts.end()), inserts.end());
+    shuffle(inserts.begin(), inserts.end(), rng);
+    for (auto key : inserts)
+        index.insert(key, key);
+    index.waitForRetrain();
+
+    vector<uint64_t> queries(keys);
+    queries.insert(queries.end(), inserts.begin(), inserts.end());
+    shuffle(queries.begin(), queries.end(), rng);
+
+    size_t missing;
+    std::cout << "before compaction: buffer size " << bufferSize(index) << ", nodes " << index.directory.size()
+              << ", memory " << index.memoryConsumption() << " bytes" << std::endl;
+    std::cout << "before compaction: lookup latency " << lookupLatency(index, queries, missing) << " ns, not found "
+              << missing << std::endl;
+
+    // lookups go on while the maintenance thread compacts
+    CompactionStats stats;
+    std::atomic<bool> compacting(true);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::thread maintenance([&]
+                            { stats = index.compact(); compacting = false; });
+    size_t online_missing = 0;
+    for (size_t i = 0; compacting; i = (i + 1) % queries.size())
+    {
+        bool exist;
+        index.find(queries[i], exist);
+        online_missing += !exist;
+    }
+    maintenance.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "compaction: " << stats.nodes << " nodes rebuilt as " << stats.newNodes << ", buffered keys "
+              << stats.bufferBefore << " -> " << stats.bufferAfter << ", "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+              << " ms, not found during compaction " << online_missing << std::endl;
+
+    std::cout << "after compaction: buffer size " << bufferSize(index) << ", nodes " << index.directory.size()
+              << ", memory " << index.memoryConsumption() << " bytes" << std::endl;
+    std::cout << "after compaction: lookup latency " << lookupLatency(index, queries, missing) << " ns, not found "
+              << missing << std::endl;
+    return 0;
+}
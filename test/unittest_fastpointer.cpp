@@ -0,0 +1,79 @@
+//
+// Insert throughput of the ART buffer against the number of fast pointers it maintains.
+// usage: unittest_fastpointer [number of keys] [most fast pointers] [threads]
+//
+
+#include "artolc.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace alt_index;
+
+#define BASE_NUMBER 1000000
+#define MAX_FAST_POINTERS 100000
+
+typedef artInterface<uint64_t, uint64_t> Buffer;
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BASE_NUMBER;
+    const int max_fast = argc > 2 ? atoi(argv[2]) : MAX_FAST_POINTERS;
+    const int thread_num = argc > 3 ? atoi(argv[3]) : max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::mt19937_64 rng(2023);
+
+    vector<uint64_t> base(key_num), inserts(key_num);
+    for (auto &key : base)
+        key = rng() >> 1;
+    for (auto &key : inserts)
+        key = rng() >> 1;
+    sort(base.begin(), base.end());
+    base.erase(unique(base.begin(), base.end()), base.end());
+
+    for (int fast_num = 1; fast_num <= max_fast; fast_num *= 10)
+    {
+        Buffer buffer;
+        for (auto key : base)
+            buffer.put(key, key + 1);
+
+        // one fast pointer per range of adjacent keys, every one on the node the range branches in
+        const size_t step = max<size_t>(1, base.size() / fast_num);
+        for (size_t i = 0; i + 1 < base.size() && i / step < static_cast<size_t>(fast_num); i += step)
+        {
+            int index;
+            buffer.build_fast_pointer(base[i], base[i + 1], index);
+        }
+        vector<uint64_t> levels;
+        buffer.get_fast_pointer(levels);
+
+        // new keys grow nodes, which redirects their fast pointers
+        auto start = std::chrono::high_resolution_clock::now();
+        vector<std::thread> threads;
+        for (int t = 0; t < thread_num; t++)
+        {
+            threads.emplace_back([&, t]
+                                 {
+                                     for (size_t i = t; i < inserts.size(); i += thread_num)
+                                         buffer.put(inserts[i], inserts[i] + 1);
+                                 });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+        size_t missing = 0;
+        for (auto key : inserts)
+        {
+            uint64_t value;
+            missing += !buffer.get(key, value) || value != key + 1;
+        }
+        std::cout << "fast pointers " << levels.size() << ": " << inserts.size() / seconds << " inserts/sec, "
+                  << seconds << " s, not found " << missing << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+//
+// Freeze an index into a memory-mapped file and serve lookups from it, against the index it was built from.
+// usage: unittest_frozen [number of keys] [number of inserts] [frozen file]
+//
+
+#include "frozen.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 2000000
+#define INSERT_NUMBER 500000
+
+typedef AltIndex<uint64_t, uint64_t> Index;
+typedef FrozenAltIndex<uint64_t, uint64_t> Frozen;
+
+static double secondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int insert_num = argc > 2 ? atoi(argv[2]) : INSERT_NUMBER;
+    const char *path = argc > 3 ? argv[3] : "alt_index.frozen";
+    std::mt19937_64 rng(2023);
+
+    vector<uint64_t> keys(key_num);
+    for (auto &key : keys)
+        key = rng() >> 1;
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], keys[i] + 1};
+
+    // inserts fill the buffer and expand nodes
+    Index index;
+    index.bulkLoad(data.data(), data.size());
+    vector<uint64_t> inserts(insert_num);
+    for (auto &key : inserts)
+        key = rng() >> 1;
+    for (auto key : inserts)
+        index.insert(key, key + 1);
+    keys.insert(keys.end(), inserts.begin(), inserts.end());
+    shuffle(keys.begin(), keys.end(), rng);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const bool built = Frozen::build(index, path);
+    std::cout << "build: " << (built ? "ok" : "failed") << ", " << secondsSince(start) << " s" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    Frozen frozen(path);
+    const double open_seconds = secondsSince(start);
+    std::cout << "open: " << (frozen.ok() ? "ok" : "failed") << ", " << frozen.fileSize() << " bytes, "
+              << open_seconds * 1e6 << " us" << std::endl;
+
+    size_t missing = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (auto key : keys)
+    {
+        bool exist;
+        const uint64_t value = frozen.find(key, exist);
+        missing += !exist || value != key + 1;
+    }
+    const double frozen_seconds = secondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+    for (auto key : keys)
+    {
+        bool exist;
+        index.find(key, exist);
+    }
+    const double index_seconds = secondsSince(start);
+    std::cout << "frozen find: " << frozen_seconds * 1e9 / keys.size() << " ns/op, index find: "
+              << index_seconds * 1e9 / keys.size() << " ns/op, not found " << missing << std::endl;
+
+    // absent keys are missing from both
+    size_t differ = 0;
+    for (int i = 0; i < insert_num; i++)
+    {
+        const uint64_t key = rng() >> 1;
+        bool in_frozen, in_index;
+        frozen.find(key, in_frozen);
+        index.find(key, in_index);
+        differ += in_frozen != in_index;
+    }
+    std::cout << "absent keys answered differently: " << differ << std::endl;
+
+    // damaged or mismatched files are refused when they are opened or verified
+    std::cout << "checksum: " << (frozen.verify() ? "ok" : "failed") << std::endl;
+    FILE *file = fopen(path, "r+b");
+    fseek(file, frozen.fileSize() / 2, SEEK_SET);
+    fputc(fgetc(file) ^ 0x5a, file);
+    fclose(file);
+    int refused = 0;
+    {
+        Frozen flipped(path);
+        refused += flipped.ok() && !flipped.verify();
+    }
+    truncate(path, frozen.fileSize() - 1);
+    Frozen shorter(path);
+    FrozenAltIndex<uint64_t, uint32_t> mismatched(path);
+    refused += !shorter.ok() + !mismatched.ok();
+    std::cout << "damaged files refused: " << refused << " of 3" << std::endl;
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,104 @@
+//
+// Lookup and insert latency and memory of the GPL node slot layout.
+// Built twice, as unittest_layout_aos and unittest_layout_soa (USE_SOA_LAYOUT=true).
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 2000000
+#define QUERY_NUMBER 2000000
+#define INSERT_NUMBER 1000000
+
+static double elapsedPerOp(std::chrono::high_resolution_clock::time_point start, size_t ops)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    return static_cast<double>(elapsed.count()) / ops;
+}
+
+int main()
+{
+    std::mt19937_64 rng(2023);
+
+    // even keys are bulk loaded, odd keys are inserted afterwards
+    vector<uint64_t> keys(BULK_NUMBER);
+    for (auto &key : keys)
+        key = (rng() >> 2) << 1;
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<uint64_t> inserts(INSERT_NUMBER);
+    for (auto &key : inserts)
+        key = keys[rng() % keys.size()] | 1;
+    sort(inserts.begin(), inserts.end());
+    inserts.erase(unique(inserts.begin(), inserts.end()), inserts.end());
+    shuffle(inserts.begin(), inserts.end(), rng);
+
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], i};
+
+    AltIndex<uint64_t, uint64_t> index;
+    index.bulkLoad(data.data(), data.size());
+
+    vector<uint64_t> queries(QUERY_NUMBER);
+    for (auto &query : queries)
+        query = keys[rng() % keys.size()];
+
+    std::cout << "layout: " << (USE_SOA_LAYOUT ? "SoA" : "AoS") << ", lock stripe: " << SOA_LOCK_STRIPE << std::endl;
+    std::cout << "memory after bulk load: " << index.memoryConsumption() << " bytes" << std::endl;
+
+    // read-only lookups of loaded keys
+    size_t found = 0;
+    bool exist;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto query : queries)
+    {
+        index.find(query, exist);
+        found += exist;
+    }
+    std::cout << "lookup latency: " << elapsedPerOp(start, queries.size()) << " ns, found " << found << std::endl;
+
+    // read-mostly mix: 95% lookups, 5% inserts
+    size_t j = 0;
+    found = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        if (i % 20 == 19 && j < inserts.size())
+        {
+            index.insert(inserts[j], j);
+            j++;
+        }
+        else
+        {
+            index.find(queries[i], exist);
+            found += exist;
+        }
+    }
+    std::cout << "95/5 lookup/insert latency: " << elapsedPerOp(start, queries.size()) << " ns, found " << found << std::endl;
+
+    // write-only inserts of the remaining keys
+    const size_t mixed_inserts = j;
+    start = std::chrono::high_resolution_clock::now();
+    for (; j < inserts.size(); j++)
+        index.insert(inserts[j], j);
+    std::cout << "insert latency: " << elapsedPerOp(start, inserts.size() - mixed_inserts) << " ns" << std::endl;
+
+    size_t missing = 0;
+    for (auto key : inserts)
+    {
+        index.find(key, exist);
+        missing += !exist;
+    }
+    std::cout << "memory after inserts: " << index.memoryConsumption() << " bytes, inserted keys not found: " << missing
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,81 @@
+//
+// Resident memory of an index whose nodes are rebuilt over and over. Rebuilt and evicted nodes are retired
+// and freed once no call can reach them, so the resident memory should stay close to the reachable one.
+// usage: unittest_reclaim [number of keys] [rounds] [threads]
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 200000
+#define RECLAIM_ROUNDS 10 // at most 63, the new keys of a round sit between the loaded ones
+
+static long long residentBytes()
+{
+    long long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int rounds = min(argc > 2 ? atoi(argv[2]) : RECLAIM_ROUNDS, 63);
+    const int thread_num = argc > 3 ? atoi(argv[3]) : max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::mt19937_64 rng(2023);
+
+    vector<uint64_t> keys(key_num);
+    for (auto &key : keys)
+        key = (rng() >> 8) << 6;
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], keys[i]};
+
+    AltIndex<uint64_t, uint64_t> index;
+    index.bulkLoad(data.data(), data.size());
+
+    // every round updates all keys and inserts new keys between them, which expands and rebuilds the nodes
+    size_t missing = 0;
+    for (int round = 1; round <= rounds; round++)
+    {
+        vector<std::thread> threads;
+        for (int t = 0; t < thread_num; t++)
+        {
+            threads.emplace_back([&, t]
+                                 {
+                                     for (size_t i = t; i < keys.size(); i += thread_num)
+                                     {
+                                         index.insert(keys[i] | round, keys[i]);
+                                         index.update(keys[i], keys[i] + round);
+                                     }
+                                 });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        index.waitForRetrain();
+
+        missing = 0;
+        for (auto key : keys)
+        {
+            bool exist;
+            uint64_t value = index.find(key, exist);
+            missing += !exist || value != key + round;
+        }
+        std::cout << "round " << round << ": nodes " << index.directory.size() << ", reachable "
+                  << index.memoryConsumption() << " bytes, resident " << residentBytes() << " bytes, not found "
+                  << missing << std::endl;
+    }
+    return 0;
+}
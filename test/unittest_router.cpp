@@ -0,0 +1,66 @@
+//
+// Per-lookup latency of the root routers against the number of GPL segments.
+//
+
+#include "router.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace alt_index;
+
+#define QUERY_NUMBER 1000000
+
+static double measure(const NodeRouter<uint64_t> &router, const vector<uint64_t> &node_keys, const vector<uint64_t> &queries,
+                      long long &checksum)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto query : queries)
+    {
+        checksum += router.route(&node_keys[0], node_keys.size(), query);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::nanoseconds elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    return static_cast<double>(elapsed.count()) / queries.size();
+}
+
+int main()
+{
+    std::mt19937_64 rng(2023);
+    const RouterType types[] = {RouterType::BinarySearch, RouterType::Learned, RouterType::BTree};
+    const char *names[] = {"binary search", "learned", "b-tree"};
+
+    for (int segment_num = 1000; segment_num <= 10000000; segment_num *= 10)
+    {
+        // node keys are the first keys of the segments
+        vector<uint64_t> node_keys(segment_num);
+        for (auto &key : node_keys)
+            key = rng();
+        sort(node_keys.begin(), node_keys.end());
+        node_keys.erase(unique(node_keys.begin(), node_keys.end()), node_keys.end());
+
+        vector<uint64_t> queries(QUERY_NUMBER);
+        for (auto &query : queries)
+            query = rng();
+
+        long long expected = 0;
+        for (int t = 0; t < 3; t++)
+        {
+            NodeRouter<uint64_t> router(types[t]);
+            router.build(&node_keys[0], node_keys.size());
+
+            long long checksum = 0;
+            double latency = measure(router, node_keys, queries, checksum);
+            if (t == 0)
+                expected = checksum;
+
+            std::cout << "segments: " << node_keys.size() << ", router: " << names[t] << ", lookup latency: " << latency
+                      << " ns, router memory: " << router.memoryConsumption() << " bytes"
+                      << (checksum == expected ? "" : ", WRONG RESULT") << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+//
+// Range scans against the sorted keys, alone and while other threads insert and retrain nodes.
+// usage: unittest_scan [number of keys] [number of scans] [scan length] [threads]
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 2000000
+#define SCAN_NUMBER 100000
+#define SCAN_LENGTH 100
+
+typedef AltIndex<uint64_t, uint64_t> Index;
+
+// the keys of sorted in [start, start + length) that the scan must return, in order and once each
+static size_t checkScan(Index &index, const vector<uint64_t> &sorted, size_t start, size_t length)
+{
+    const uint64_t last = sorted[min(sorted.size(), start + length) - 1];
+    size_t next = start, wrong = 0;
+    uint64_t previous = 0;
+    bool first = true;
+    index.scan(sorted[start], last, [&](const uint64_t &key, const uint64_t &value)
+               {
+                   wrong += (!first && key <= previous) || value != key + 1;
+                   first = false;
+                   previous = key;
+                   while (next < sorted.size() && sorted[next] < key)
+                       next++, wrong++;
+                   next += next < sorted.size() && sorted[next] == key;
+                   return true; });
+    return wrong + (min(sorted.size(), start + length) - next);
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int scan_num = argc > 2 ? atoi(argv[2]) : SCAN_NUMBER;
+    const int scan_len = argc > 3 ? atoi(argv[3]) : SCAN_LENGTH;
+    const int thread_num = argc > 4 ? atoi(argv[4]) : max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::mt19937_64 rng(2023);
+
+    // clustered keys, so that the buffer gets conflicts; half are bulk loaded, the other half inserted
+    vector<uint64_t> keys(key_num);
+    for (auto &key : keys)
+        key = (rng() % 4096) << 40 | (rng() % (1ULL << 24) + 1);
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<uint64_t> loaded, inserted;
+    for (size_t i = 0; i < keys.size(); i++)
+        (i % 2 == 0 ? loaded : inserted).push_back(keys[i]);
+    vector<pair<uint64_t, uint64_t>> data(loaded.size());
+    for (size_t i = 0; i < loaded.size(); i++)
+        data[i] = {loaded[i], loaded[i] + 1};
+
+    {
+        Index index;
+        index.bulkLoad(data.data(), data.size());
+        for (auto key : inserted)
+            index.insert(key, key + 1);
+
+        size_t wrong = 0, returned = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < scan_num; i++)
+        {
+            size_t first = rng() % keys.size();
+            returned += min<size_t>(scan_len, keys.size() - first);
+            wrong += checkScan(index, keys, first, scan_len);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+        vector<pair<uint64_t, uint64_t>> results(scan_len);
+        size_t first = rng() % keys.size();
+        int count = index.rangeQuery(results.data(), keys[first], scan_len);
+        for (int i = 0; i < count; i++)
+            wrong += results[i].first != keys[first + i];
+        wrong += count != static_cast<int>(min<size_t>(scan_len, keys.size() - first));
+        std::cout << "scans of " << scan_len << " keys: " << scan_num / seconds << " scans/sec, "
+                  << returned / seconds << " keys/sec, wrong " << wrong << std::endl;
+    }
+
+    {
+        // the bulk loaded keys must be returned while the others are being inserted
+        Index index;
+        index.bulkLoad(data.data(), data.size());
+        std::atomic<size_t> wrong{0};
+        std::atomic<bool> stop{false};
+        vector<std::thread> threads;
+        for (int t = 0; t < thread_num; t++)
+        {
+            threads.emplace_back([&, t]
+                                 {
+                                     if (t % 2 == 0)
+                                     {
+                                         for (size_t i = t / 2; i < inserted.size(); i += (thread_num + 1) / 2)
+                                             index.insert(inserted[i], inserted[i] + 1);
+                                         return;
+                                     }
+                                     std::mt19937_64 local(t);
+                                     while (!stop)
+                                     {
+                                         size_t first = local() % loaded.size();
+                                         const uint64_t last = loaded[min(loaded.size(), first + scan_len) - 1];
+                                         size_t next = first;
+                                         index.scan(loaded[first], last, [&](const uint64_t &key, const uint64_t &value)
+                                                    {
+                                                        wrong += value != key + 1;
+                                                        while (next < loaded.size() && loaded[next] < key)
+                                                            next++, wrong++;
+                                                        next += next < loaded.size() && loaded[next] == key;
+                                                        return true; });
+                                         wrong += min(loaded.size(), first + scan_len) - next;
+                                     } });
+        }
+        for (int t = 0; t < thread_num; t += 2)
+            threads[t].join();
+        stop = true;
+        for (int t = 1; t < thread_num; t += 2)
+            threads[t].join();
+        size_t scanned = index.scan(0, std::numeric_limits<uint64_t>::max(), [](const uint64_t &, const uint64_t &)
+                                    { return true; });
+        std::cout << "threads " << thread_num << ": wrong " << wrong << ", keys " << scanned << " of " << keys.size()
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+//
+// Insert/remove churn on the ART buffer, with the allocation statistics of the node and record slabs.
+// usage: unittest_slab [keys per thread] [threads] [rounds]
+//
+
+#include "artolc.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace alt_index;
+
+#define CHURN_KEYS 200000
+#define CHURN_ROUNDS 10
+
+typedef artInterface<uint64_t, uint64_t> Buffer;
+
+static void printStats(const char *name, const ART::SlabStats &stats)
+{
+    std::cout << "  " << name << ": live " << stats.live << ", free " << stats.free << ", reserved "
+              << stats.reserved << " bytes" << std::endl;
+}
+
+static void printAllStats()
+{
+    printStats("N4", ART_OLC::N::slabStats(ART_OLC::NTypes::N4));
+    printStats("N16", ART_OLC::N::slabStats(ART_OLC::NTypes::N16));
+    printStats("N48", ART_OLC::N::slabStats(ART_OLC::NTypes::N48));
+    printStats("N256", ART_OLC::N::slabStats(ART_OLC::NTypes::N256));
+    printStats("records", Buffer::recordStats());
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : CHURN_KEYS;
+    const int thread_num = argc > 2 ? atoi(argv[2]) : max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int rounds = argc > 3 ? atoi(argv[3]) : CHURN_ROUNDS;
+
+    // every thread churns keys of its own, spread over the whole key space
+    vector<vector<uint64_t>> keys(thread_num);
+    std::mt19937_64 rng(2023);
+    for (auto &thread_keys : keys)
+    {
+        thread_keys.resize(key_num);
+        for (auto &key : thread_keys)
+            key = rng() >> 1;
+    }
+
+    Buffer buffer;
+    vector<size_t> missing(thread_num, 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    vector<std::thread> threads;
+    for (int t = 0; t < thread_num; t++)
+    {
+        threads.emplace_back([&, t]
+                             {
+                                 for (int round = 0; round < rounds; round++)
+                                 {
+                                     for (auto key : keys[t])
+                                         buffer.put(key, key + round);
+                                     for (auto key : keys[t])
+                                     {
+                                         uint64_t value;
+                                         missing[t] += !buffer.get(key, value) || value != key + round;
+                                     }
+                                     for (auto key : keys[t])
+                                         buffer.remove(key);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+
+    size_t not_found = 0;
+    for (size_t count : missing)
+        not_found += count;
+    const double ops = 3.0 * key_num * thread_num * rounds;
+    std::cout << "threads " << thread_num << ", rounds " << rounds << ": " << ops / seconds << " ops/sec, "
+              << seconds << " s, not found " << not_found << ", keys left " << buffer.index->leafCount() << std::endl;
+    printAllStats();
+    return 0;
+}
@@ -0,0 +1,151 @@
+//
+// Save an index to a snapshot file and load it into a new index, against bulk loading the same keys.
+// usage: unittest_snapshot [number of keys] [number of inserts] [snapshot file]
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 2000000
+#define INSERT_NUMBER 500000
+
+typedef AltIndex<uint64_t, uint64_t> Index;
+
+static double secondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+}
+
+static long fileSize(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// rewrite one byte of the file, or cut it there if cut is set
+static void damage(const char *from, const char *to, long pos, bool cut)
+{
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+    vector<char> bytes(1 << 20);
+    long copied = 0;
+    size_t n;
+    while ((n = fread(bytes.data(), 1, bytes.size(), in)) > 0)
+    {
+        if (copied <= pos && pos < copied + static_cast<long>(n))
+        {
+            if (cut)
+                n = pos - copied;
+            else
+                bytes[pos - copied] ^= 0x5a;
+        }
+        fwrite(bytes.data(), 1, n, out);
+        copied += n;
+        if (cut && copied >= pos)
+            break;
+    }
+    fclose(in);
+    fclose(out);
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int insert_num = argc > 2 ? atoi(argv[2]) : INSERT_NUMBER;
+    const char *path = argc > 3 ? argv[3] : "alt_index.snapshot";
+    std::mt19937_64 rng(2023);
+
+    vector<uint64_t> keys(key_num);
+    for (auto &key : keys)
+        key = rng() >> 1;
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    vector<pair<uint64_t, uint64_t>> data(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        data[i] = {keys[i], keys[i] + 1};
+
+    Index index;
+    auto start = std::chrono::high_resolution_clock::now();
+    index.bulkLoad(data.data(), data.size());
+    std::cout << "bulk load: " << secondsSince(start) << " s" << std::endl;
+
+    // inserts fill the buffer and expand nodes
+    vector<uint64_t> inserts(insert_num);
+    for (auto &key : inserts)
+        key = rng() >> 1;
+    for (auto key : inserts)
+        index.insert(key, key + 1);
+    keys.insert(keys.end(), inserts.begin(), inserts.end());
+
+    start = std::chrono::high_resolution_clock::now();
+    bool saved = index.saveSnapshot(path);
+    double seconds = secondsSince(start);
+    const long size = fileSize(path);
+    std::cout << "save: " << (saved ? "ok" : "failed") << ", " << size << " bytes, " << seconds << " s, "
+              << size / seconds / (1 << 20) << " MB/s" << std::endl;
+
+    Index loaded;
+    start = std::chrono::high_resolution_clock::now();
+    bool ok = loaded.loadSnapshot(path);
+    seconds = secondsSince(start);
+    std::cout << "load: " << (ok ? "ok" : "failed") << ", " << seconds << " s, " << size / seconds / (1 << 20)
+              << " MB/s" << std::endl;
+
+    size_t missing = 0;
+    for (auto key : keys)
+    {
+        bool exist;
+        uint64_t value = loaded.find(key, exist);
+        missing += !exist || value != key + 1;
+    }
+    size_t scanned = 0, expected = 0;
+    index.scan(0, numeric_limits<uint64_t>::max(), [&](uint64_t, uint64_t)
+               { expected++; return true; });
+    loaded.scan(0, numeric_limits<uint64_t>::max(), [&](uint64_t, uint64_t)
+                { scanned++; return true; });
+    std::cout << "loaded index: not found " << missing << ", scanned " << scanned << " of " << expected
+              << ", memory " << loaded.memoryConsumption() << " of " << index.memoryConsumption() << " bytes"
+              << std::endl;
+
+    // the loaded index takes writes like the saved one
+    for (size_t i = 0; i < inserts.size(); i++)
+        loaded.insert(inserts[i] ^ 1, inserts[i]);
+    missing = 0;
+    for (auto key : inserts)
+    {
+        bool exist;
+        missing += loaded.find(key ^ 1, exist) != key || !exist;
+    }
+    std::cout << "inserts after loading: not found " << missing << std::endl;
+
+    // damaged files are refused and leave the index empty
+    const string damaged = string(path) + ".damaged";
+    int refused = 0;
+    for (long pos : {8L, size / 3, size / 2, size - 1})
+    {
+        damage(path, damaged.c_str(), pos, false);
+        Index flipped;
+        refused += !flipped.loadSnapshot(damaged.c_str()) && flipped.directory.size() == 0;
+        damage(path, damaged.c_str(), pos, true);
+        Index cut;
+        refused += !cut.loadSnapshot(damaged.c_str()) && cut.directory.size() == 0;
+    }
+    std::cout << "damaged snapshots refused: " << refused << " of 8" << std::endl;
+    remove(damaged.c_str());
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,145 @@
+//
+// Throughput of durable inserts through the write-ahead log against in-memory inserts, for several group commit
+// delays, and recovery of the index from a snapshot and its log.
+// usage: unittest_wal [number of keys] [inserts per thread] [threads] [log file]
+//
+
+#include "alt_index.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+
+using namespace std;
+using namespace alt_index;
+
+#define BULK_NUMBER 200000
+#define DURABLE_INSERTS 2000
+#define WAL_THREADS 8
+
+typedef AltIndex<uint64_t, uint64_t> Index;
+typedef WriteAheadLog<uint64_t, uint64_t> Log;
+
+// every thread inserts keys of its own and updates every other one of them
+static double run(Index &index, const vector<vector<uint64_t>> &keys)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    vector<std::thread> threads;
+    for (size_t t = 0; t < keys.size(); t++)
+    {
+        threads.emplace_back([&, t]
+                             {
+                                 for (size_t i = 0; i < keys[t].size(); i++)
+                                 {
+                                     index.insert(keys[t][i], keys[t][i]);
+                                     if (i % 2 == 1)
+                                         index.update(keys[t][i - 1], keys[t][i - 1] + 1);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+}
+
+static size_t missing(Index &index, const vector<vector<uint64_t>> &keys)
+{
+    size_t not_found = 0;
+    for (auto &thread_keys : keys)
+    {
+        for (size_t i = 0; i < thread_keys.size(); i++)
+        {
+            bool exist;
+            const uint64_t value = index.find(thread_keys[i], exist);
+            const uint64_t expected = thread_keys[i] + (i % 2 == 0 && i + 1 < thread_keys.size());
+            not_found += !exist || value != expected;
+        }
+    }
+    return not_found;
+}
+
+int main(int argc, char **argv)
+{
+    const int key_num = argc > 1 ? atoi(argv[1]) : BULK_NUMBER;
+    const int insert_num = argc > 2 ? atoi(argv[2]) : DURABLE_INSERTS;
+    const int thread_num = argc > 3 ? atoi(argv[3]) : WAL_THREADS;
+    const string log_path = argc > 4 ? argv[4] : "alt_index.wal";
+    const string snapshot_path = log_path + ".snapshot";
+    std::mt19937_64 rng(2023);
+
+    vector<uint64_t> base(key_num);
+    for (auto &key : base)
+        key = (rng() >> 1) & ~1ULL;
+    sort(base.begin(), base.end());
+    base.erase(unique(base.begin(), base.end()), base.end());
+    vector<pair<uint64_t, uint64_t>> data(base.size());
+    for (size_t i = 0; i < base.size(); i++)
+        data[i] = {base[i], base[i]};
+    vector<vector<uint64_t>> keys(thread_num, vector<uint64_t>(insert_num));
+    for (auto &thread_keys : keys)
+    {
+        for (auto &key : thread_keys)
+            key = (rng() >> 1) | 1;
+    }
+    const double ops = 1.5 * insert_num * thread_num;
+
+    {
+        Index index;
+        index.bulkLoad(data.data(), data.size());
+        const double seconds = run(index, keys);
+        std::cout << "in memory: " << ops / seconds << " ops/sec" << std::endl;
+    }
+
+    for (int delay : {0, 100, 1000})
+    {
+        for (bool sync : {true, false})
+        {
+            remove(log_path.c_str());
+            Index index;
+            index.bulkLoad(data.data(), data.size());
+            Log log(log_path.c_str(), delay, sync);
+            index.wal = &log;
+            index.checkpoint(snapshot_path.c_str());
+            const double seconds = run(index, keys);
+            std::cout << (sync ? "fdatasync" : "write only") << ", group delay " << delay << " us: " << ops / seconds
+                      << " ops/sec, " << log.syncCount() << " group commits, "
+                      << ops / max(1LL, log.syncCount()) << " records per commit" << std::endl;
+        }
+    }
+
+    // the index of the last run is gone, it is recovered from its snapshot and log, whose last block is torn
+    FILE *file = fopen(log_path.c_str(), "ab");
+    fwrite("torn block", 1, 10, file);
+    fclose(file);
+    {
+        Log log(log_path.c_str());
+        Index index;
+        auto start = std::chrono::high_resolution_clock::now();
+        const long long replayed = index.recover(snapshot_path.c_str(), &log);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "recovery: " << replayed << " records replayed in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+                  << " ms, not found " << missing(index, keys) << std::endl;
+
+        // writes after recovery go on in the same log, a checkpoint drops them from it
+        index.insert(2 * base.back() + 1, 7);
+        index.checkpoint(snapshot_path.c_str());
+        index.insert(2 * base.back() + 3, 9);
+    }
+    {
+        Log log(log_path.c_str());
+        Index index;
+        const long long replayed = index.recover(snapshot_path.c_str(), &log);
+        bool exist_first, exist_second;
+        index.find(2 * base.back() + 1, exist_first);
+        index.find(2 * base.back() + 3, exist_second);
+        std::cout << "recovery after checkpoint: " << replayed << " records replayed, not found "
+                  << missing(index, keys) + !exist_first + !exist_second << std::endl;
+    }
+    remove(log_path.c_str());
+    remove(snapshot_path.c_str());
+    return 0;
+}